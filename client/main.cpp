@@ -4,388 +4,296 @@
 #include <stdexcept>
 #include <iterator>
 #include <fstream>
-#include <functional>
 #include <algorithm>
-#include <iomanip>
+#include <memory>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "tile.h"
+#include "kernels.h"
+#include "cache.h"
+#include "game.h"
+#include "bots.h"
+#include "board.h"
 
 using namespace std;
 
-using value_type = uint32_t;
-
-namespace color
+// extends every set on the field with tiles from the hand, runs at both ends
+// and groups with every missing color. jokers are wildcards, every candidate
+// is checked by counting them instead of trying what they could stand for
+void appendToField( Combinations &field, Hand &hand )
 {
-	enum type
+	for ( auto &set : field )
 	{
-		red = 1 << 0,
-		yellow = 1 << 1,
-		blue = 1 << 2,
-		black = 1 << 3,
-		mask = 0xF
-	};
+		extend( set, hand );
+	}
 }
 
-static const vector< color::type > colors = {
-	color::red,
-	color::yellow,
-	color::blue,
-	color::black
-};
-
-namespace number
+// takes the longest run or, when there is none, a group of three or more
+// out of the hand, or else a pair completed by a joker. empty when the hand
+// holds none of them
+RUMMIKUB_KERNEL
+Set findNumberSequence( Hand &hand )
 {
-	enum type
-	{
-		one = 1 << 4,
-		two = 1 << 5,
-		three = 1 << 6,
-		four = 1 << 7,
-		five = 1 << 8,
-		six = 1 << 9,
-		seven = 1 << 10,
-		eight = 1 << 11,
-		nine = 1 << 12,
-		ten = 1 << 13,
-		eleven = 1 << 14,
-		twelve = 1 << 15,
-		thirteen = 1 << 16,
-		mask = 0x1FFF0
-	};
-}
-
-static const vector< number::type > numbers = {
-	number::one,
-	number::two,
-	number::three,
-	number::four,
-	number::five,
-	number::six,
-	number::seven,
-	number::eight,
-	number::nine,
-	number::ten,
-	number::eleven,
-	number::twelve,
-	number::thirteen
-};
-
-class Tile
-{
-	public:
-			
-		Tile( number::type n, color::type c ) :
-			data_( n | c ) {}
-		
-		Tile( color::type n, number::type c ) :
-			data_( n | c ) {}
+	const Board board( hand );
+	Set set;
 	
-		Tile() :
-			data_( 0 ) {}
-		
-		operator value_type() const
+	size_t best = 0, color = 0, first = 0;
+	for ( size_t c = 0; c < Rules::colors; ++c )
+	{
+		size_t start;
+		const auto length = longestRun( board.lane( 0, c ), start );
+		if ( length > best )
 		{
-			return data_;
+			best = length;
+			color = c;
+			first = start;
 		}
-		
-		bool valid() const
+	}
+	
+	if ( best >= 3 )
+	{
+		for ( size_t n = first; n < first + best; ++n )
 		{
-			return ( data_ & color::mask ) && ( data_ & number::mask );
+			set.push_back( Tile::fromValue( n, color ) );
 		}
-		
-		color::type color() const
+	}
+	else if ( const auto numbers = board.groups()[ 0 ] )
+	{
+		const size_t n = lowest_bit( numbers ) + 1;
+		for ( size_t c = 0; c < Rules::colors; ++c )
 		{
-			return static_cast< color::type >( data_ & color::mask );
+			if ( board.has( Tile::fromValue( n, c ) ) )
+			{
+				set.push_back( Tile::fromValue( n, c ) );
+			}
 		}
-		
-		number::type number() const
+	}
+	
+	else if ( hand.count( Tile::joker() ) )
+	{
+		Tile a, b;
+		if ( jokerPair( board, a, b ) )
 		{
-			return static_cast< number::type >( data_ & number::mask );
+			set.push_back( Tile::joker() );
+			set.push_back( a );
+			set.push_back( b );
 		}
-		
-	private:
-		value_type data_;
-};
-
-using Strings = vector< string >;
-using Tiles = vector< Tile >;
-
-Tiles operator + ( Tiles a, const Tiles &b )
-{
-	a.insert( a.end(), b.begin(), b.end() );
-	return a;
-}
-
-istream& operator >> ( istream &str, Tile &tile )
-{
-	char c = 0;
-	int t = 0;
-	str >> c;
-	switch ( c )
-	{
-		case 'A': case 'B': case 'C': case 'D':
-			break;
-		default:
-			return str;
 	}
-	str >> t;
-	if ( t > 0 && t < 14 )
+	
+	for ( auto t : set )
 	{
-		tile = Tile{
-			static_cast< number::type >( 1 << ( t + 3 ) ),
-			static_cast< color::type >( 1 << ( c - 'A' ) )
-		};
+		hand.remove( t );
 	}
-	return str;
+	return set;
 }
 
-size_t value( number::type t )
+bool operator == ( const Set &a, const Set &b )
 {
-	switch ( t )
-	{
-		case number::one:
-			return 1;
-		case number::two:
-			return 2;
-		case number::three:
-			return 3;
-		case number::four:
-			return 4;
-		case number::five:
-			return 5;
-		case number::six:
-			return 6;
-		case number::seven:
-			return 7;
-		case number::eight:
-			return 8;
-		case number::nine:
-			return 9;
-		case number::ten:
-			return 10;
-		case number::eleven:
-			return 11;
-		case number::twelve:
-			return 12;
-		case number::thirteen:
-			return 13;
-		default:
-			return 0;
-	}
+	return a.size() == b.size() && equal( a.begin(), a.end(), b.begin() );
 }
 
-ostream& operator << ( ostream &stream, const Tile &t )
+bool operator == ( const Move &a, const Move &b )
 {
-	switch ( t.color() )
-	{
-		case color::red:
-			stream << 'A';
-			break;
-		case color::yellow:
-			stream << 'B';
-			break;
-		case color::blue:
-			stream << 'C';
-			break;
-		case color::black:
-			stream << 'D';
-			break;
-		default:
-			throw runtime_error( "unknown color" );
-	}
-	
-	stream << setw( 2 ) << setfill( '0' ) << value( t.number() );
-	
-	return stream;
+	return a.removed == b.removed && a.added == b.added;
 }
 
-struct Combinations : vector< Tiles >
+// tiles that are neither in the hand nor on the field, so they are held by
+// the opponents or still in the pool
+Tiles unseenTiles( const Hand &hand, const Combinations &field )
 {
-	Tiles tiles() const
+	Hand seen = hand;
+	for ( auto &set : field )
 	{
-		Tiles result;
-		for ( auto &set : *this )
+		for ( auto t : set )
 		{
-			result.insert( result.end(), set.begin(), set.end() );
+			seen.add( t );
 		}
-		return result;
 	}
-};
-
-struct Option
-{
-	Combinations sets;
-	Tiles inhand;
-	Tiles tiles() const
+	
+	Tiles result;
+	for ( auto t : init_tiles() )
 	{
-		Tiles total { inhand };
-		for ( auto &s : sets )
+		if ( seen.count( t ) )
 		{
-			total.insert( total.end(), s.begin(), s.end() );
+			seen.remove( t );
+		}
+		else
+		{
+			result.push_back( t );
 		}
-		return total;
-	}
-};
-
-using Options = vector< Option >;
-
-template < typename T >
-istream& operator >> ( istream &str, T &tiles )
-{
-	typename T::value_type t;
-	while ( str >> t )
-	{
-		tiles.push_back( t );
 	}
-	return str;
-}
-
-ostream& operator << ( ostream &stream, const Tiles &t )
-{
-	auto dst = ostream_iterator< Tiles::value_type >( stream, " " );
-	copy( begin( t ), end( t ), dst );
-	return stream;
-}
-
-ostream& operator << ( ostream &stream, const Combinations &t )
-{
-	auto dst = ostream_iterator< Combinations::value_type >( stream, "\n" );
-	copy( begin( t ), end( t ), dst );
-	return stream;
-}
-
-template < typename T, typename Cmp >
-void sort( T &t, Cmp c )
-{
-	sort( begin( t ), end( t ), c );
-}
-
-template < typename T >
-void sort( T &t )
-{
-	sort( begin( t ), end( t ) );
-}
-
-inline value_type hamming_weight( value_type n )
-{
-	n = n - ((n>>1) & 0x55555555);
-	n = (n & 0x33333333) + ((n>>2) & 0x33333333);
-	return (((n + (n>>4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-}
-
-inline bool adjecent( value_type a, value_type b )
-{
-	return ( ( a >> 1 ) | ( a << 1 ) ) & b;
-}
-
-using filter_type = function< bool(value_type) >;
-
-template < typename Container >
-Container operator | ( Container container, filter_type f )
-{
-	container.erase( remove_if( container.begin(), container.end(), f ), container.end() );
-	return container;
+	return result;
 }
 
-filter_type keep( value_type t )
+// everything one search thread touches, allocated up front so the rollouts
+// themselves do not allocate
+struct Rollout
 {
-	return { [t]( value_type i ) { return ( i & t ) == 0; } };
-}
-
-filter_type remove( value_type t )
-{
-	return { [t]( value_type i ) { return ( i & t ) != 0; } };
-}
-
-template < typename T >
-T unique( T source )
-{
-	source.erase( unique( source.begin(), source.end() ), source.end() );
-	return source;
-}
-
-value_type mask( const Tiles &tiles )
-{
-	value_type m = 0;
-	for ( auto &t : tiles ) m |= t;
-	return m;
-}
+	Rollout( unsigned seed, size_t players, size_t candidates ) :
+		random( seed ),
+		hands( players ),
+		state( Tiles(), hands ),
+		policy( makeStrategy( "greedy" ) ),
+		wins( candidates ),
+		samples( 0 ) {}
+	
+	mt19937 random;
+	Tiles deal;
+	vector< Tiles > hands;
+	GameState state;
+	Move move;
+	unique_ptr< Strategy > policy;
+	vector< double > wins;
+	size_t samples;
+};
 
-void removeFromTiles( Tiles &tiles, const Tiles remove )
+// determinized monte carlo lookahead. every sample deals the unseen tiles to
+// the opponents and the pool at random, then plays every candidate move out
+// with greedy bots on that same deal. the candidate that wins most often
+// within the time budget is played
+class Lookahead
 {
-	for ( auto &r : remove )
-	{
-		for ( auto i = tiles.begin(); i != tiles.end(); ++i )
+	public:
+		
+		Lookahead( const Tiles &hand, const Combinations &field, size_t opponents ) :
+			field_( field ),
+			unseen_( unseenTiles( Hand( hand ), field ) ),
+			hands_( opponents + 1 ),
+			root_( Tiles(), { hand }, field )
 		{
-			if ( *i == r )
+			hands_[ 0 ] = hand;
+			
+			// the opponents are assumed to hold as many tiles as we do
+			handSize_ = min( hand.size(), unseen_.size() / ( opponents + 1 ) );
+			
+			for ( auto name : { "append", "greedy" } )
 			{
-				tiles.erase( i );
-				break;
+				Move move;
+				makeStrategy( name )->play( root_, move );
+				if ( !move.draw() && root_.check( move ) == MoveError::none &&
+					find( candidates_.begin(), candidates_.end(), move ) == candidates_.end() )
+				{
+					candidates_.push_back( move );
+				}
 			}
+			candidates_.push_back( Move() );
 		}
-	}
-}
-
-void appendToField( Combinations &field, Tiles &hand )
-{
-	for ( auto &set : field )
-	{
-		const auto m = mask( set );
-		const auto colorMask = static_cast< color::type >( m & color::mask );
-		const auto numberMask = static_cast< number::type >( m & number::mask );
-		switch ( colorMask )
+		
+		Combinations play( chrono::milliseconds budget, size_t threads )
 		{
-			case color::red:
-			case color::yellow:
-			case color::blue:
-			case color::black:
+			size_t best = 0;
+			
+			if ( candidates_.size() > 1 )
 			{
-				auto required = Tile( static_cast< number::type >( set.front().number() - 1 ), colorMask );
-				auto found = find( hand.begin(), hand.end(), required );
-				if ( found != hand.end() )
+				const auto deadline = chrono::steady_clock::now() + budget;
+				atomic< unsigned > seed( 0 );
+				
+				vector< unique_ptr< Rollout > > workers;
+				for ( size_t i = 0; i < threads; ++i )
 				{
-					set.insert( set.begin(), *found );
-					hand.erase( found );
+					workers.emplace_back( new Rollout( i, hands_.size(), candidates_.size() ) );
 				}
-				required = Tile( static_cast< number::type >( set.back().number() + 1 ), colorMask );
-				found = find( hand.begin(), hand.end(), required );
-				if ( found != hand.end() )
+				
+				vector< thread > pool;
+				for ( auto &w : workers )
 				{
-					set.push_back( *found );
-					hand.erase( found );
+					auto worker = w.get();
+					pool.emplace_back( [this, worker, deadline, &seed]()
+					{
+						while ( chrono::steady_clock::now() < deadline )
+						{
+							worker->random.seed( seed++ );
+							sample( *worker );
+						}
+					} );
 				}
+				for ( auto &t : pool )
+				{
+					t.join();
+				}
+				
+				vector< double > wins( candidates_.size() );
+				for ( auto &w : workers )
+				{
+					for ( size_t c = 0; c < wins.size(); ++c )
+					{
+						wins[ c ] += w->wins[ c ];
+					}
+				}
+				best = max_element( wins.begin(), wins.end() ) - wins.begin();
 			}
-			default:
-				break;
+			
+			GameState result( Tiles(), { hands_[ 0 ] }, field_ );
+			result.apply( candidates_[ best ] );
+			return result.field();
 		}
-		switch ( numberMask )
+		
+	private:
+		
+		void sample( Rollout &r )
 		{
-			case number::one:
-			case number::two:
-			case number::three:
-			case number::four:
-			case number::five:
-			case number::six:
-			case number::seven:
-			case number::eight:
-			case number::nine:
-			case number::ten:
-			case number::eleven:
-			case number::twelve:
+			r.deal.assign( unseen_.begin(), unseen_.end() );
+			shuffle( r.deal.begin(), r.deal.end(), r.random );
+			
+			r.hands[ 0 ].assign( hands_[ 0 ].begin(), hands_[ 0 ].end() );
+			for ( size_t p = 1; p < r.hands.size(); ++p )
 			{
-				auto add = unique( hand | keep( numberMask ) | remove( colorMask ) );
-				set.insert( set.end(), add.begin(), add.end() );
-				sort( set.begin(), set.end() );
-				removeFromTiles( hand, add );
+				r.hands[ p ].assign( r.deal.end() - handSize_, r.deal.end() );
+				r.deal.resize( r.deal.size() - handSize_ );
 			}
-			default:
-				break;
+			r.state.reset( r.deal, r.hands, field_ );
+			
+			for ( size_t c = 0; c < candidates_.size(); ++c )
+			{
+				r.state.apply( candidates_[ c ] );
+				
+				for ( size_t ply = 0; ply < maxPlies && !r.state.finished(); ++ply )
+				{
+					r.policy->play( r.state, r.move );
+					if ( r.state.apply( r.move ) != MoveError::none )
+					{
+						break;
+					}
+				}
+				
+				// a win counts 1, sharing the lowest score counts half
+				const auto ours = r.state.hand( 0 ).points();
+				double score = 1;
+				for ( size_t p = 1; p < r.state.players(); ++p )
+				{
+					const auto theirs = r.state.hand( p ).points();
+					if ( theirs < ours )
+					{
+						score = 0;
+					}
+					else if ( theirs == ours )
+					{
+						score = min( score, 0.5 );
+					}
+				}
+				r.wins[ c ] += score;
+				
+				while ( r.state.depth() )
+				{
+					r.state.undo();
+				}
+			}
+			++r.samples;
 		}
-	}
-}
-
-Tiles findNumberSequence( Tiles &hand )
-{
-	return {};
-}
+		
+		static const size_t maxPlies = 400;
+		
+		Combinations field_;
+		Tiles unseen_;
+		vector< Tiles > hands_;
+		GameState root_;
+		size_t handSize_;
+		vector< Move > candidates_;
+};
 
 int main(int,char**)
 {
@@ -403,7 +311,7 @@ int main(int,char**)
 			}
 		}
 		Tiles hand;
-		istringstream( line ) >> hand;
+		parse( line, hand );
 		while ( getline( input, line ) )
 		{
 			if ( line == "field" )
@@ -415,22 +323,67 @@ int main(int,char**)
 		Combinations field;
 		while ( getline( input, line ) )
 		{
-			Tiles tiles;
-			istringstream( line ) >> tiles;
+			Set tiles;
+			parse( line, tiles );
 			if ( !tiles.empty() )
 			{
 				field.push_back( tiles );
 			}
 		}
 		
-		appendToField( field, hand );
+		// RUMMIKUB_LOOKAHEAD_MS=<ms> searches with the monte carlo lookahead
+		// against RUMMIKUB_OPPONENTS opponents (default 1) instead
+		const char *lookahead = getenv( "RUMMIKUB_LOOKAHEAD_MS" );
+		const char *opponents = getenv( "RUMMIKUB_OPPONENTS" );
+		const int searchMs = lookahead ? atoi( lookahead ) : 0;
+		const int searchOpponents = max( 1, opponents ? atoi( opponents ) : 1 );
 		
-		for ( auto found = findNumberSequence( hand ); !found.empty(); )
+		// RUMMIKUB_CACHE=<file> reuses answers from earlier turns and games,
+		// the settings of the search are part of the key
+		unique_ptr< SolverCache > cache;
+		string key, answer;
+		if ( const char *path = getenv( "RUMMIKUB_CACHE" ) )
 		{
-			field.push_back( found );
+			cache.reset( new SolverCache( path ) );
+			key = SolverCache::key( hand, field );
+			if ( searchMs > 0 )
+			{
+				key += "lookahead" + to_string( searchMs ) + "opponents" + to_string( searchOpponents );
+			}
+			if ( cache->find( key, answer ) )
+			{
+				cout << answer;
+				return 0;
+			}
 		}
 		
-		cout << field << endl;
+		if ( searchMs > 0 )
+		{
+			Lookahead search( hand, field, searchOpponents );
+			field = search.play( chrono::milliseconds( searchMs ), max( 1u, thread::hardware_concurrency() ) );
+		}
+		else
+		{
+			// new sets first so the jokers complete pairs before they are
+			// used up as wildcards on the field
+			Hand index( hand );
+			for ( auto found = findNumberSequence( index ); !found.empty(); found = findNumberSequence( index ) )
+			{
+				field.push_back( found );
+			}
+			
+			appendToField( field, index );
+		}
+		
+		ostringstream output;
+		output << field << endl;
+		answer = output.str();
+		cout << answer;
+		
+		if ( cache )
+		{
+			cache->insert( key, answer );
+		}
 	}
 	catch ( const exception &err )
 	{
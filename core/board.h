@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "game.h"
+#include "kernels.h"
+#include "validate.h"
+
+// a hand as bitboards with one lane per copy and color. bit n - 1 of
+// lane( copy, color ) is set when the hand holds more than copy tiles of
+// number n in that color, so lane( 0, c ) is every number held in color c.
+// the enumeration kernels work on all lanes at once with shifts, ands and a
+// bit sliced adder, the loops over the lanes have a fixed trip count so the
+// compiler can vectorize them
+class Board
+{
+	public:
+		
+		static constexpr size_t lanes = Rules::copies * Rules::colors;
+		static constexpr uint32_t numbers = ( 1u << Rules::numbers ) - 1;
+		
+		using Lanes = std::array< uint32_t, lanes >;
+		using Copies = std::array< uint32_t, Rules::copies >;
+		
+		explicit Board( const Hand &hand ) :
+			lanes_()
+		{
+			for ( size_t n = 1; n <= Rules::numbers; ++n )
+			{
+				for ( size_t c = 0; c < Rules::colors; ++c )
+				{
+					const auto count = hand.count( Tile::fromValue( n, c ) );
+					for ( size_t p = 0; p < Rules::copies && p < count; ++p )
+					{
+						lanes_[ p * Rules::colors + c ] |= 1u << ( n - 1 );
+					}
+				}
+			}
+		}
+		
+		uint32_t lane( size_t copy, size_t color ) const
+		{
+			return lanes_[ copy * Rules::colors + color ];
+		}
+		
+		// numbered tiles on the board
+		size_t size() const
+		{
+			size_t total = 0;
+			for ( auto l : lanes_ )
+			{
+				total += hamming_weight( l );
+			}
+			return total;
+		}
+		
+		bool has( Tile t, size_t copy = 0 ) const
+		{
+			return lane( copy, t.colorIndex() ) >> ( t.value() - 1 ) & 1;
+		}
+		
+		// takes the highest copy of t off the board, the joker is not on it
+		void remove( Tile t )
+		{
+			if ( t.isJoker() )
+			{
+				return;
+			}
+			for ( size_t p = Rules::copies; p--; )
+			{
+				auto &l = lanes_[ p * Rules::colors + t.colorIndex() ];
+				if ( l >> ( t.value() - 1 ) & 1 )
+				{
+					l &= ~( 1u << ( t.value() - 1 ) );
+					return;
+				}
+			}
+		}
+		
+		// per lane, the numbers where a run of at least length tiles starts
+		Lanes runs( size_t length = 3 ) const
+		{
+			Lanes starts = lanes_;
+			for ( size_t k = 1; k < length; ++k )
+			{
+				for ( size_t i = 0; i < lanes; ++i )
+				{
+					starts[ i ] &= lanes_[ i ] >> k;
+				}
+			}
+			return starts;
+		}
+		
+		// per copy, the numbers held in at least minimum colors. the colors of
+		// every number are counted in bit slices, a ripple carry adder over the
+		// color lanes, and compared against minimum without leaving that form
+		Copies groups( size_t minimum = 3 ) const
+		{
+			std::array< Copies, slices > sum {};
+			for ( size_t c = 0; c < Rules::colors; ++c )
+			{
+				Copies carry;
+				for ( size_t p = 0; p < Rules::copies; ++p )
+				{
+					carry[ p ] = lanes_[ p * Rules::colors + c ];
+				}
+				for ( size_t b = 0; b < slices; ++b )
+				{
+					for ( size_t p = 0; p < Rules::copies; ++p )
+					{
+						const uint32_t next = sum[ b ][ p ] & carry[ p ];
+						sum[ b ][ p ] ^= carry[ p ];
+						carry[ p ] = next;
+					}
+				}
+			}
+			
+			Copies greater {}, equal;
+			for ( size_t p = 0; p < Rules::copies; ++p )
+			{
+				equal[ p ] = numbers;
+			}
+			for ( size_t b = slices; b--; )
+			{
+				for ( size_t p = 0; p < Rules::copies; ++p )
+				{
+					if ( minimum >> b & 1 )
+					{
+						equal[ p ] &= sum[ b ][ p ];
+					}
+					else
+					{
+						greater[ p ] |= equal[ p ] & sum[ b ][ p ];
+						equal[ p ] &= ~sum[ b ][ p ];
+					}
+				}
+			}
+			for ( size_t p = 0; p < Rules::copies; ++p )
+			{
+				greater[ p ] |= equal[ p ];
+			}
+			return greater;
+		}
+	
+	private:
+		
+		// enough bits to count every color
+		static constexpr size_t slices = Rules::colors < 8 ? 3 : 4;
+		
+		Lanes lanes_;
+};
+
+// the longest run of held numbers in mask, its first number and length.
+// every round of the chain shortens each run by one, so the last non empty
+// round holds the starts of the longest runs
+inline size_t longestRun( uint32_t mask, size_t &first )
+{
+	size_t length = 0;
+	uint32_t starts = 0;
+	for ( ; mask; mask &= mask >> 1 )
+	{
+		starts = mask;
+		++length;
+	}
+	first = length ? lowest_bit( starts ) + 1 : 0;
+	return length;
+}
+
+// two held tiles that a joker turns into a set: neighbours or numbers one
+// apart in a color, or one number in two colors. false when there are none
+inline bool jokerPair( const Board &board, Tile &a, Tile &b )
+{
+	for ( size_t c = 0; c < Rules::colors; ++c )
+	{
+		const auto lane = board.lane( 0, c );
+		for ( size_t gap = 1; gap <= 2; ++gap )
+		{
+			if ( const auto pairs = lane & lane >> gap )
+			{
+				const size_t n = lowest_bit( pairs ) + 1;
+				a = Tile::fromValue( n, c );
+				b = Tile::fromValue( n + gap, c );
+				return true;
+			}
+		}
+	}
+	
+	if ( const auto numbers = board.groups( 2 )[ 0 ] )
+	{
+		const size_t n = lowest_bit( numbers ) + 1;
+		Tile *next = &a;
+		for ( size_t c = 0; c < Rules::colors; ++c )
+		{
+			if ( board.has( Tile::fromValue( n, c ) ) )
+			{
+				*next = Tile::fromValue( n, c );
+				if ( next == &b )
+				{
+					return true;
+				}
+				next = &b;
+			}
+		}
+	}
+	return false;
+}
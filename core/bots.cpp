@@ -0,0 +1,166 @@
+#include "bots.h"
+#include "board.h"
+
+using namespace std;
+
+namespace
+{
+	RUMMIKUB_KERNEL
+	void extendField( const GameState &state, Hand &hand, Move &move )
+	{
+		auto &field = state.field();
+		for ( size_t i = 0; i < field.size(); ++i )
+		{
+			Set set = field[ i ];
+			if ( extend( set, hand ) )
+			{
+				move.removed.push_back( i );
+				move.added.push_back( set );
+			}
+		}
+	}
+	
+	// puts down the longest run of every color and then every group of three
+	// or more, repeated while the hand still holds one, and then pairs with a
+	// joker. all are read off the first copy lanes of the hand's bitboard
+	RUMMIKUB_KERNEL
+	void layDown( Hand &hand, Move &move )
+	{
+		Board board( hand );
+		
+		// every set takes three tiles, fewer can only go out with a joker
+		for ( bool found = true; found && board.size() >= 3; )
+		{
+			found = false;
+			
+			for ( size_t c = 0; c < Rules::colors; ++c )
+			{
+				size_t first;
+				const auto length = longestRun( board.lane( 0, c ), first );
+				if ( length >= 3 )
+				{
+					Set set;
+					for ( size_t n = first; n < first + length; ++n )
+					{
+						set.push_back( Tile::fromValue( n, c ) );
+						hand.remove( set.back() );
+						board.remove( set.back() );
+					}
+					move.added.push_back( set );
+					found = true;
+				}
+			}
+			
+			for ( auto numbers = board.groups()[ 0 ]; numbers; numbers &= numbers - 1 )
+			{
+				const size_t n = lowest_bit( numbers ) + 1;
+				Set set;
+				for ( size_t c = 0; c < Rules::colors; ++c )
+				{
+					const auto t = Tile::fromValue( n, c );
+					if ( board.has( t ) )
+					{
+						set.push_back( t );
+					}
+				}
+				for ( auto t : set )
+				{
+					hand.remove( t );
+					board.remove( t );
+				}
+				move.added.push_back( set );
+				found = true;
+			}
+		}
+		
+		// the jokers complete pairs that are a set short of one tile
+		for ( Tile a, b; hand.count( Tile::joker() ) && jokerPair( board, a, b ); )
+		{
+			Set set;
+			set.push_back( Tile::joker() );
+			set.push_back( a );
+			set.push_back( b );
+			for ( auto t : set )
+			{
+				hand.remove( t );
+				board.remove( t );
+			}
+			move.added.push_back( set );
+		}
+	}
+	
+	// never plays, a baseline for the others
+	class Draw : public Strategy
+	{
+		public:
+			
+			const char* name() const override
+			{
+				return "draw";
+			}
+			
+			void play( const GameState&, Move &move ) override
+			{
+				move.clear();
+			}
+	};
+	
+	// only adds tiles to sets already on the field, like the r_client bot
+	class Append : public Strategy
+	{
+		public:
+			
+			const char* name() const override
+			{
+				return "append";
+			}
+			
+			void play( const GameState &state, Move &move ) override
+			{
+				move.clear();
+				Hand hand = state.hand( state.current() );
+				extendField( state, hand, move );
+			}
+	};
+	
+	// extends the field and then lays down every run and group it can
+	class Greedy : public Strategy
+	{
+		public:
+			
+			const char* name() const override
+			{
+				return "greedy";
+			}
+			
+			void play( const GameState &state, Move &move ) override
+			{
+				move.clear();
+				Hand hand = state.hand( state.current() );
+				layDown( hand, move );
+				extendField( state, hand, move );
+			}
+	};
+}
+
+unique_ptr< Strategy > makeStrategy( const string &name )
+{
+	if ( name == "draw" )
+	{
+		return unique_ptr< Strategy >( new Draw );
+	}
+	if ( name == "append" )
+	{
+		return unique_ptr< Strategy >( new Append );
+	}
+	if ( name == "greedy" )
+	{
+		return unique_ptr< Strategy >( new Greedy );
+	}
+	return nullptr;
+}
+
+vector< string > strategyNames()
+{
+	return { "draw", "append", "greedy" };
+}
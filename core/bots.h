@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "game.h"
+
+// a bot that is compiled into the server and plays on the GameState directly
+class Strategy
+{
+	public:
+		
+		virtual ~Strategy() {}
+		
+		virtual const char* name() const = 0;
+		
+		// fills move with the turn of state.current(), an empty move draws
+		virtual void play( const GameState &state, Move &move ) = 0;
+};
+
+// nullptr when there is no native bot with that name
+std::unique_ptr< Strategy > makeStrategy( const std::string &name );
+
+std::vector< std::string > strategyNames();
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+// fixed width values of the binary files (datasets, results, checkpoints),
+// all in host byte order
+namespace bytes
+{
+	template < typename T >
+	void put( std::vector< uint8_t > &out, T value )
+	{
+		const auto p = reinterpret_cast< const uint8_t* >( &value );
+		out.insert( out.end(), p, p + sizeof( T ) );
+	}
+	
+	// the value at p, which does not have to be aligned
+	template < typename T >
+	T get( const uint8_t *p )
+	{
+		T value;
+		memcpy( &value, p, sizeof( T ) );
+		return value;
+	}
+	
+	// the value at p, and p moves past it. the caller checks the length
+	template < typename T >
+	T take( const uint8_t *&p )
+	{
+		const auto value = get< T >( p );
+		p += sizeof( T );
+		return value;
+	}
+	
+	inline bool writeAll( FILE *file, const void *data, size_t size )
+	{
+		return !size || fwrite( data, 1, size, file ) == size;
+	}
+	
+	// retries the short writes a pipe or a signal can cause
+	inline bool writeAll( int fd, const void *data, size_t size )
+	{
+		auto p = static_cast< const char* >( data );
+		while ( size )
+		{
+			const auto n = write( fd, p, size );
+			if ( n <= 0 )
+			{
+				return false;
+			}
+			p += n;
+			size -= n;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,264 @@
+#include "cache.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct SolverCache::Header
+{
+	char magic[ 4 ];
+	uint32_t version;
+	uint32_t ids;
+	uint32_t slots;
+	uint64_t used;
+};
+
+namespace
+{
+	const char magic[ 4 ] = { 'R', 'K', 'S', 'C' };
+	const uint32_t version = 1;
+	const size_t npos = size_t( -1 );
+	
+	// hash, key length, value length
+	const size_t recordHeader = 16;
+	
+	uint64_t fnv1a( const string &s )
+	{
+		uint64_t h = 14695981039346656037ull;
+		for ( unsigned char c : s )
+		{
+			h = ( h ^ c ) * 1099511628211ull;
+		}
+		return h;
+	}
+	
+	bool readAll( int fd, void *data, size_t size, uint64_t offset )
+	{
+		auto p = static_cast< char* >( data );
+		while ( size )
+		{
+			const auto n = pread( fd, p, size, offset );
+			if ( n <= 0 )
+			{
+				return false;
+			}
+			p += n;
+			size -= n;
+			offset += n;
+		}
+		return true;
+	}
+	
+	bool writeAll( int fd, const void *data, size_t size, uint64_t offset )
+	{
+		auto p = static_cast< const char* >( data );
+		while ( size )
+		{
+			const auto n = pwrite( fd, p, size, offset );
+			if ( n <= 0 )
+			{
+				return false;
+			}
+			p += n;
+			size -= n;
+			offset += n;
+		}
+		return true;
+	}
+	
+	struct Lock
+	{
+		explicit Lock( int fd ) : fd( fd ) { flock( fd, LOCK_EX ); }
+		~Lock() { flock( fd, LOCK_UN ); }
+		int fd;
+	};
+}
+
+SolverCache::SolverCache( const string &path, size_t slots ) :
+	fd_( open( path.c_str(), O_RDWR | O_CREAT, 0644 ) ),
+	header_( nullptr ),
+	slots_( nullptr ),
+	mapped_( 0 )
+{
+	if ( fd_ < 0 )
+	{
+		throw runtime_error( "could not open cache: " + path );
+	}
+	
+	// a power of two so a hash maps to a slot with a mask
+	size_t capacity = 1;
+	while ( capacity < slots )
+	{
+		capacity <<= 1;
+	}
+	
+	{
+		Lock lock( fd_ );
+		struct stat info;
+		if ( fstat( fd_, &info ) == 0 && info.st_size == 0 )
+		{
+			Header header {};
+			memcpy( header.magic, magic, 4 );
+			header.version = version;
+			header.ids = Rules::ids;
+			header.slots = capacity;
+			if ( ftruncate( fd_, sizeof( Header ) + capacity * sizeof( uint64_t ) ) != 0 ||
+				!writeAll( fd_, &header, sizeof( header ), 0 ) )
+			{
+				close( fd_ );
+				throw runtime_error( "could not create cache: " + path );
+			}
+		}
+	}
+	
+	Header header;
+	if ( !readAll( fd_, &header, sizeof( header ), 0 ) ||
+		memcmp( header.magic, magic, 4 ) != 0 ||
+		header.version != version ||
+		header.ids != Rules::ids )
+	{
+		close( fd_ );
+		throw runtime_error( "not a cache for this build: " + path );
+	}
+	
+	mapped_ = sizeof( Header ) + header.slots * sizeof( uint64_t );
+	void *p = mmap( nullptr, mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0 );
+	if ( p == MAP_FAILED )
+	{
+		close( fd_ );
+		throw runtime_error( "could not map cache: " + path );
+	}
+	header_ = static_cast< Header* >( p );
+	slots_ = reinterpret_cast< uint64_t* >( header_ + 1 );
+}
+
+SolverCache::~SolverCache()
+{
+	munmap( header_, mapped_ );
+	close( fd_ );
+}
+
+string SolverCache::key( const Tiles &hand, const Combinations &field )
+{
+	string result( Rules::ids, '\0' );
+	for ( auto t : hand )
+	{
+		++result[ t.id() ];
+	}
+	
+	vector< string > sets;
+	sets.reserve( field.size() );
+	for ( auto &set : field )
+	{
+		string s;
+		for ( auto t : set )
+		{
+			s.push_back( t.id() );
+		}
+		std::sort( s.begin(), s.end() );
+		sets.push_back( s );
+	}
+	std::sort( sets.begin(), sets.end() );
+	
+	for ( auto &s : sets )
+	{
+		result += s;
+		result.push_back( '\0' );
+	}
+	return result;
+}
+
+size_t SolverCache::probe( const string &key, uint64_t hash, bool &found, string *value ) const
+{
+	found = false;
+	const size_t mask = header_->slots - 1;
+	for ( size_t n = 0, i = hash & mask; n <= mask; ++n, i = ( i + 1 ) & mask )
+	{
+		const uint64_t offset = __atomic_load_n( &slots_[ i ], __ATOMIC_ACQUIRE );
+		if ( !offset )
+		{
+			return i;
+		}
+		
+		uint64_t record[ 2 ];
+		if ( !readAll( fd_, record, recordHeader, offset ) )
+		{
+			continue;
+		}
+		
+		const uint32_t keySize = record[ 1 ] & 0xFFFFFFFF;
+		const uint32_t valueSize = record[ 1 ] >> 32;
+		if ( record[ 0 ] != hash || keySize != key.size() )
+		{
+			continue;
+		}
+		
+		string stored( keySize + valueSize, '\0' );
+		if ( readAll( fd_, &stored[ 0 ], stored.size(), offset + recordHeader ) &&
+			stored.compare( 0, keySize, key ) == 0 )
+		{
+			if ( value )
+			{
+				value->assign( stored, keySize, valueSize );
+			}
+			found = true;
+			return i;
+		}
+	}
+	return npos;
+}
+
+bool SolverCache::find( const string &key, string &value ) const
+{
+	bool found;
+	probe( key, fnv1a( key ), found, &value );
+	return found;
+}
+
+void SolverCache::insert( const string &key, const string &value )
+{
+	const auto hash = fnv1a( key );
+	
+	Lock lock( fd_ );
+	
+	if ( header_->used * 10 >= uint64_t( header_->slots ) * 7 )
+	{
+		return;
+	}
+	
+	bool found;
+	const auto slot = probe( key, hash, found, nullptr );
+	if ( slot == npos || found )
+	{
+		return;
+	}
+	
+	struct stat info;
+	if ( fstat( fd_, &info ) != 0 )
+	{
+		return;
+	}
+	
+	// the record is complete on disk before its offset becomes visible
+	const uint64_t offset = info.st_size;
+	string record( recordHeader, '\0' );
+	const uint64_t sizes = uint64_t( value.size() ) << 32 | key.size();
+	memcpy( &record[ 0 ], &hash, 8 );
+	memcpy( &record[ 8 ], &sizes, 8 );
+	record += key;
+	record += value;
+	if ( !writeAll( fd_, record.data(), record.size(), offset ) )
+	{
+		return;
+	}
+	
+	__atomic_store_n( &slots_[ slot ], offset, __ATOMIC_RELEASE );
+	++header_->used;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+#include "tile.h"
+
+// on disk cache of solved positions shared by every invocation of a bot.
+// a fixed size open addressing table of record offsets is mapped into
+// memory, the records (hash, full key, value) are appended behind it. keys
+// are compared in full so a hash collision can never return a wrong answer.
+// inserts are serialized between processes with flock, lookups take no lock
+class SolverCache
+{
+	public:
+		
+		// opens the cache at path, creating it with room for slots entries
+		explicit SolverCache( const std::string &path, size_t slots = 1 << 18 );
+		~SolverCache();
+		
+		SolverCache( const SolverCache& ) = delete;
+		SolverCache& operator = ( const SolverCache& ) = delete;
+		
+		// canonical bytes of a position, independent of the order of the hand,
+		// of the sets on the field and of the tiles within a set
+		static std::string key( const Tiles &hand, const Combinations &field );
+		
+		bool find( const std::string &key, std::string &value ) const;
+		
+		// stores value unless the key is present or the table is 70% full
+		void insert( const std::string &key, const std::string &value );
+		
+	private:
+		
+		struct Header;
+		
+		// slot of key, or the empty slot where it belongs, npos when full
+		size_t probe( const std::string &key, uint64_t hash, bool &found, std::string *value ) const;
+		
+		int fd_;
+		Header *header_;
+		uint64_t *slots_;
+		size_t mapped_;
+};
@@ -0,0 +1,524 @@
+#include "dataset.h"
+#include "bytes.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef RUMMIKUB_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+	const uint32_t version = 2;
+	const char fileMagic[ 4 ] = { 'R', 'K', 'D', 'S' };
+	const char chunkMagic[ 4 ] = { 'C', 'H', 'N', 'K' };
+	const char indexMagic[ 4 ] = { 'I', 'N', 'D', 'X' };
+	const char trailerMagic[ 4 ] = { 'R', 'K', 'I', 'X' };
+	
+	const size_t columnEntry = 12;
+	const size_t chunkHeader = 8 + columnEntry * dataset::columns;
+	
+	using bytes::put;
+	using bytes::get;
+	
+	void append( FILE *file, const vector< uint8_t > &data )
+	{
+		if ( !bytes::writeAll( file, data.data(), data.size() ) )
+		{
+			throw runtime_error( "could not write dataset" );
+		}
+	}
+}
+
+size_t dataset::width( Column c )
+{
+	switch ( c )
+	{
+		case game:
+			return 8;
+		case turn:
+		case pool:
+		case points:
+			return 2;
+		case player:
+		case rank:
+			return 1;
+		case hand:
+			return Rules::ids;
+		default:
+			return 0;
+	}
+}
+
+const char* dataset::name( Column c )
+{
+	static const char *names[] = {
+		"game", "turn", "player", "pool", "hand", "field", "removed", "added", "rank", "points"
+	};
+	return c < columns ? names[ c ] : "unknown";
+}
+
+void DatasetWriter::Chunk::clear()
+{
+	rows = 0;
+	for ( auto &d : data )
+	{
+		d.clear();
+	}
+	for ( auto &o : offsets )
+	{
+		o.clear();
+	}
+}
+
+DatasetWriter::DatasetWriter( const string &path, size_t chunkRows ) :
+	current_( new Chunk ),
+	chunkRows_( chunkRows ),
+	game_( 0 ),
+	turn_( 0 ),
+	gameStart_( 0 ),
+	file_( fopen( path.c_str(), "wb" ) ),
+	closing_( false ),
+	failed_( false )
+{
+	if ( !file_ )
+	{
+		throw runtime_error( "could not open dataset: " + path );
+	}
+	
+	vector< uint8_t > header( fileMagic, fileMagic + 4 );
+	put< uint32_t >( header, version );
+	put< uint32_t >( header, dataset::columns );
+	put< uint32_t >( header, Rules::ids );
+	append( file_, header );
+	
+	writer_ = thread( [this]() { run(); } );
+}
+
+DatasetWriter::~DatasetWriter()
+{
+	try
+	{
+		close();
+	}
+	catch ( ... )
+	{
+	}
+}
+
+void DatasetWriter::beginGame( uint64_t game )
+{
+	game_ = game;
+	turn_ = 0;
+	gameStart_ = current_->rows;
+}
+
+void DatasetWriter::turn( const GameState &state, const Move &move )
+{
+	auto &c = *current_;
+	auto &data = c.data;
+	
+	put< uint64_t >( data[ dataset::game ], game_ );
+	put< uint16_t >( data[ dataset::turn ], turn_++ );
+	put< uint8_t >( data[ dataset::player ], state.current() );
+	put< uint16_t >( data[ dataset::pool ], state.pool().size() );
+	
+	auto &counts = state.hand( state.current() ).counts();
+	data[ dataset::hand ].insert( data[ dataset::hand ].end(), counts.begin(), counts.end() );
+	
+	if ( c.offsets[ dataset::field ].empty() )
+	{
+		c.offsets[ dataset::field ].push_back( 0 );
+		c.offsets[ dataset::removed ].push_back( 0 );
+		c.offsets[ dataset::added ].push_back( 0 );
+	}
+	
+	for ( auto &set : state.field() )
+	{
+		for ( auto t : set )
+		{
+			data[ dataset::field ].push_back( t.id() );
+		}
+		data[ dataset::field ].push_back( 0 );
+	}
+	for ( auto i : move.removed )
+	{
+		data[ dataset::removed ].push_back( uint8_t( i ) );
+	}
+	for ( auto &set : move.added )
+	{
+		for ( auto t : set )
+		{
+			data[ dataset::added ].push_back( t.id() );
+		}
+		data[ dataset::added ].push_back( 0 );
+	}
+	for ( auto col : { dataset::field, dataset::removed, dataset::added } )
+	{
+		c.offsets[ col ].push_back( data[ col ].size() );
+	}
+	
+	// the outcome is filled in by endGame
+	put< uint8_t >( data[ dataset::rank ], 0 );
+	put< uint16_t >( data[ dataset::points ], 0 );
+	
+	++c.rows;
+}
+
+void DatasetWriter::endGame( const GameState &state )
+{
+	auto &c = *current_;
+	
+	vector< uint16_t > points( state.players() );
+	vector< uint8_t > rank( state.players(), 1 );
+	for ( size_t p = 0; p < points.size(); ++p )
+	{
+		points[ p ] = state.hand( p ).points();
+	}
+	for ( size_t p = 0; p < points.size(); ++p )
+	{
+		for ( auto other : points )
+		{
+			rank[ p ] += other < points[ p ];
+		}
+	}
+	
+	for ( size_t row = gameStart_; row < c.rows; ++row )
+	{
+		const auto player = c.data[ dataset::player ][ row ];
+		c.data[ dataset::rank ][ row ] = rank[ player ];
+		memcpy( &c.data[ dataset::points ][ row * 2 ], &points[ player ], 2 );
+	}
+	
+	gameStart_ = c.rows;
+	
+	if ( c.rows >= chunkRows_ )
+	{
+		submit();
+	}
+}
+
+void DatasetWriter::submit()
+{
+	lock_guard< mutex > lock( mutex_ );
+	queue_.push_back( move( current_ ) );
+	if ( free_.empty() )
+	{
+		current_.reset( new Chunk );
+	}
+	else
+	{
+		current_ = move( free_.back() );
+		free_.pop_back();
+	}
+	gameStart_ = 0;
+	wake_.notify_one();
+}
+
+void DatasetWriter::run()
+{
+	unique_lock< mutex > lock( mutex_ );
+	for ( ;; )
+	{
+		wake_.wait( lock, [this]() { return closing_ || !queue_.empty(); } );
+		if ( queue_.empty() )
+		{
+			return;
+		}
+		
+		auto chunk = move( queue_.front() );
+		queue_.pop_front();
+		
+		lock.unlock();
+		if ( !failed_ )
+		{
+			try
+			{
+				write( *chunk );
+			}
+			catch ( const exception& )
+			{
+				failed_ = true;
+			}
+		}
+		chunk->clear();
+		lock.lock();
+		
+		free_.push_back( move( chunk ) );
+	}
+}
+
+void DatasetWriter::write( Chunk &chunk )
+{
+	const uint64_t offset = ftello( file_ );
+	
+	vector< uint8_t > header( chunkMagic, chunkMagic + 4 );
+	put< uint32_t >( header, chunk.rows );
+	
+	vector< uint8_t > body;
+	for ( size_t i = 0; i < dataset::columns; ++i )
+	{
+		const auto col = static_cast< dataset::Column >( i );
+		
+		// variable width columns get their offsets in front of the data
+		auto &data = chunk.data[ col ];
+		if ( !dataset::width( col ) )
+		{
+			auto &offsets = chunk.offsets[ col ];
+			const auto p = reinterpret_cast< const uint8_t* >( offsets.data() );
+			data.insert( data.begin(), p, p + offsets.size() * sizeof( uint32_t ) );
+		}
+		
+		auto codec = dataset::raw;
+		const uint8_t *stored = data.data();
+		size_t size = data.size();
+		
+#ifdef RUMMIKUB_HAVE_ZLIB
+		uLongf length = compressBound( data.size() );
+		compressed_.resize( length );
+		if ( compress2( compressed_.data(), &length, data.data(), data.size(), Z_BEST_SPEED ) == Z_OK && length < data.size() )
+		{
+			codec = dataset::deflate;
+			stored = compressed_.data();
+			size = length;
+		}
+#endif
+		
+		put< uint8_t >( header, codec );
+		header.insert( header.end(), 3, 0 );
+		put< uint32_t >( header, data.size() );
+		put< uint32_t >( header, size );
+		body.insert( body.end(), stored, stored + size );
+	}
+	
+	append( file_, header );
+	append( file_, body );
+	
+	index_.emplace_back( offset, chunk.rows );
+}
+
+void DatasetWriter::close()
+{
+	if ( !file_ )
+	{
+		return;
+	}
+	
+	if ( current_->rows )
+	{
+		submit();
+	}
+	
+	{
+		lock_guard< mutex > lock( mutex_ );
+		closing_ = true;
+		wake_.notify_one();
+	}
+	writer_.join();
+	
+	if ( failed_ )
+	{
+		fclose( file_ );
+		file_ = nullptr;
+		throw runtime_error( "could not write dataset" );
+	}
+	
+	const uint64_t offset = ftello( file_ );
+	vector< uint8_t > index( indexMagic, indexMagic + 4 );
+	put< uint32_t >( index, index_.size() );
+	for ( auto &entry : index_ )
+	{
+		put< uint64_t >( index, entry.first );
+		put< uint32_t >( index, entry.second );
+		put< uint32_t >( index, 0 );
+	}
+	put< uint64_t >( index, offset );
+	index.insert( index.end(), trailerMagic, trailerMagic + 4 );
+	
+	auto file = file_;
+	file_ = nullptr;
+	append( file, index );
+	if ( fclose( file ) != 0 )
+	{
+		throw runtime_error( "could not write dataset" );
+	}
+}
+
+DatasetReader::DatasetReader( const string &path ) :
+	data_( nullptr ),
+	size_( 0 )
+{
+	const int fd = open( path.c_str(), O_RDONLY );
+	if ( fd < 0 )
+	{
+		throw runtime_error( "could not open dataset: " + path );
+	}
+	
+	struct stat info;
+	if ( fstat( fd, &info ) == 0 && info.st_size > 0 )
+	{
+		size_ = info.st_size;
+		void *p = mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+		data_ = p == MAP_FAILED ? nullptr : static_cast< const uint8_t* >( p );
+	}
+	::close( fd );
+	
+	// the destructor does not run when the constructor throws
+	auto fail = [this]( const string &why )
+	{
+		if ( data_ )
+		{
+			munmap( const_cast< uint8_t* >( data_ ), size_ );
+			data_ = nullptr;
+		}
+		throw runtime_error( why );
+	};
+	
+	if ( !data_ || size_ < 28 || memcmp( data_, fileMagic, 4 ) != 0 )
+	{
+		fail( "not a dataset: " + path );
+	}
+	if ( get< uint32_t >( data_ + 4 ) != version ||
+		get< uint32_t >( data_ + 8 ) != dataset::columns ||
+		get< uint32_t >( data_ + 12 ) != Rules::ids )
+	{
+		fail( "dataset was written by a different build: " + path );
+	}
+	if ( memcmp( data_ + size_ - 4, trailerMagic, 4 ) != 0 )
+	{
+		fail( "dataset is incomplete: " + path );
+	}
+	
+	// every offset and size is checked against the file before it is used,
+	// the chunks lie between the file header and the index
+	const auto index = get< uint64_t >( data_ + size_ - 12 );
+	if ( index < 16 || index > size_ - 20 || memcmp( data_ + index, indexMagic, 4 ) != 0 )
+	{
+		fail( "corrupt dataset: " + path );
+	}
+	const auto count = get< uint32_t >( data_ + index + 4 );
+	if ( count > ( size_ - 12 - index - 8 ) / 16 )
+	{
+		fail( "corrupt dataset: " + path );
+	}
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const auto entry = data_ + index + 8 + i * 16;
+		const auto offset = get< uint64_t >( entry );
+		if ( offset < 16 || offset > index || index - offset < chunkHeader ||
+			memcmp( data_ + offset, chunkMagic, 4 ) != 0 )
+		{
+			fail( "corrupt dataset: " + path );
+		}
+		
+		const auto header = data_ + offset;
+		uint64_t stored = 0;
+		for ( size_t c = 0; c < dataset::columns; ++c )
+		{
+			const auto column = header + 8 + c * columnEntry;
+			stored += get< uint32_t >( column + 8 );
+			if ( column[ 0 ] == dataset::raw && get< uint32_t >( column + 4 ) != get< uint32_t >( column + 8 ) )
+			{
+				fail( "corrupt dataset: " + path );
+			}
+		}
+		if ( stored > index - offset - chunkHeader )
+		{
+			fail( "corrupt dataset: " + path );
+		}
+		
+		chunks_.push_back( { header, get< uint32_t >( entry + 8 ) } );
+	}
+}
+
+DatasetReader::~DatasetReader()
+{
+	if ( data_ )
+	{
+		munmap( const_cast< uint8_t* >( data_ ), size_ );
+		data_ = nullptr;
+	}
+}
+
+DatasetReader::Blob DatasetReader::column( size_t chunk, dataset::Column c, vector< uint8_t > &buffer ) const
+{
+	const auto header = chunks_[ chunk ].header;
+	
+	const uint8_t *p = header + chunkHeader;
+	for ( size_t i = 0; i < size_t( c ); ++i )
+	{
+		p += get< uint32_t >( header + 8 + i * columnEntry + 8 );
+	}
+	
+	const auto entry = header + 8 + c * columnEntry;
+	const auto codec = entry[ 0 ];
+	const size_t raw = get< uint32_t >( entry + 4 );
+	const size_t stored = get< uint32_t >( entry + 8 );
+	
+	Blob blob;
+	if ( codec == dataset::raw )
+	{
+		blob = { p, stored };
+	}
+#ifdef RUMMIKUB_HAVE_ZLIB
+	else if ( codec == dataset::deflate )
+	{
+		buffer.resize( raw );
+		uLongf length = raw;
+		if ( uncompress( buffer.data(), &length, p, stored ) != Z_OK || length != raw )
+		{
+			throw runtime_error( "corrupt dataset chunk" );
+		}
+		blob = { buffer.data(), raw };
+	}
+#endif
+	else
+	{
+		throw runtime_error( "unsupported dataset codec" );
+	}
+	
+	// the layout row() and the callers rely on: rows values of a fixed width,
+	// or rows + 1 ascending offsets that stay inside the column
+	const size_t rows = chunks_[ chunk ].rows;
+	if ( const auto w = dataset::width( c ) )
+	{
+		if ( blob.size != rows * w )
+		{
+			throw runtime_error( "corrupt dataset chunk" );
+		}
+		return blob;
+	}
+	
+	const size_t offsets = ( rows + 1 ) * 4;
+	if ( blob.size < offsets )
+	{
+		throw runtime_error( "corrupt dataset chunk" );
+	}
+	uint32_t last = 0;
+	for ( size_t r = 0; r <= rows; ++r )
+	{
+		const auto next = get< uint32_t >( blob.data + r * 4 );
+		if ( next < last || next > blob.size - offsets )
+		{
+			throw runtime_error( "corrupt dataset chunk" );
+		}
+		last = next;
+	}
+	return blob;
+}
+
+DatasetReader::Blob DatasetReader::row( Blob column, size_t rows, size_t row )
+{
+	const auto begin = get< uint32_t >( column.data + row * 4 );
+	const auto end = get< uint32_t >( column.data + row * 4 + 4 );
+	return { column.data + ( rows + 1 ) * 4 + begin, end - begin };
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "game.h"
+
+// columnar record of every turn of a set of games, meant for training move
+// ranking models. rows are grouped in chunks, every column of a chunk is
+// stored (deflated when that helps) on its own so a reader only decodes the
+// columns it needs. all integers are stored in host byte order.
+//
+//   file    "RKDS" u32 version, u32 columns, u32 tile ids
+//   chunk   "CHNK" u32 rows, per column { u8 codec, u8[3], u32 raw size,
+//           u32 stored size }, then the column data back to back
+//   index   "INDX" u32 chunks, per chunk { u64 offset, u32 rows, u32 }
+//   trailer u64 index offset, "RKIX"
+//
+// fixed width columns hold rows * width bytes. variable width columns hold
+// u32 offsets[ rows + 1 ] followed by the bytes of every row
+namespace dataset
+{
+	enum Column
+	{
+		game,       // u64 seed the game was dealt from
+		turn,       // u16 turn within the game
+		player,     // u8 player to move
+		pool,       // u16 tiles left in the pool
+		hand,       // u8[ Rules::ids ] count of every tile id in the hand
+		field,      // var, tile ids of every set, each set ends with a 0
+		removed,    // var, u8 field indices of the sets the move takes apart
+		added,      // var, tile ids of every set the move puts down, 0 terminated
+		rank,       // u8 final position of the player, 1 is the winner
+		points,     // u16 points left in the hand of the player at the end
+		columns
+	};
+	
+	// bytes per row, 0 for variable width columns
+	size_t width( Column c );
+	
+	const char* name( Column c );
+	
+	enum Codec : uint8_t
+	{
+		raw = 0,
+		deflate = 1
+	};
+}
+
+class DatasetWriter
+{
+	public:
+		
+		// rows are buffered until a game ends and written in chunks of at
+		// least chunkRows rows by a background thread
+		explicit DatasetWriter( const std::string &path, size_t chunkRows = 8192 );
+		~DatasetWriter();
+		
+		DatasetWriter( const DatasetWriter& ) = delete;
+		DatasetWriter& operator = ( const DatasetWriter& ) = delete;
+		
+		void beginGame( uint64_t game );
+		
+		// records the position before move is applied to state
+		void turn( const GameState &state, const Move &move );
+		
+		// fills in the outcome of every turn of the game
+		void endGame( const GameState &state );
+		
+		// writes the remaining rows and the index, called by the destructor
+		void close();
+		
+	private:
+		
+		struct Chunk
+		{
+			size_t rows { 0 };
+			std::array< std::vector< uint8_t >, dataset::columns > data;
+			std::array< std::vector< uint32_t >, dataset::columns > offsets;
+			
+			void clear();
+		};
+		
+		void submit();
+		void run();
+		void write( Chunk &chunk );
+		
+		std::unique_ptr< Chunk > current_;
+		size_t chunkRows_;
+		uint64_t game_;
+		uint16_t turn_;
+		size_t gameStart_;
+		
+		std::FILE *file_;
+		std::vector< std::pair< uint64_t, uint32_t > > index_;
+		std::vector< uint8_t > compressed_;
+		
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::deque< std::unique_ptr< Chunk > > queue_;
+		std::vector< std::unique_ptr< Chunk > > free_;
+		bool closing_;
+		bool failed_;
+		std::thread writer_;
+};
+
+// read only view of a dataset file through mmap
+class DatasetReader
+{
+	public:
+		
+		struct Blob
+		{
+			const uint8_t *data;
+			size_t size;
+		};
+		
+		explicit DatasetReader( const std::string &path );
+		~DatasetReader();
+		
+		DatasetReader( const DatasetReader& ) = delete;
+		DatasetReader& operator = ( const DatasetReader& ) = delete;
+		
+		size_t chunks() const
+		{
+			return chunks_.size();
+		}
+		
+		size_t rows( size_t chunk ) const
+		{
+			return chunks_[ chunk ].rows;
+		}
+		
+		// one column of one chunk. raw columns point into the mapping, others
+		// are inflated into buffer
+		Blob column( size_t chunk, dataset::Column c, std::vector< uint8_t > &buffer ) const;
+		
+		// row of a variable width column blob
+		static Blob row( Blob column, size_t rows, size_t row );
+		
+	private:
+		
+		struct ChunkInfo
+		{
+			const uint8_t *header;
+			size_t rows;
+		};
+		
+		const uint8_t *data_;
+		size_t size_;
+		std::vector< ChunkInfo > chunks_;
+};
@@ -0,0 +1,233 @@
+#include "feed.h"
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+	const char magic[ 4 ] = { 'R', 'K', 'F', 'D' };
+	const uint32_t version = 1;
+	
+	void* map( int fd, size_t size, bool writable )
+	{
+		void *p = mmap( nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+		return p == MAP_FAILED ? nullptr : p;
+	}
+}
+
+namespace feed
+{
+	struct Header
+	{
+		char magic[ 4 ];
+		uint32_t version;
+		uint32_t ids;
+		uint32_t slots;
+		uint32_t frameSize;
+		uint32_t reserved;
+		
+		// frames published, the writer stores it after the frame is complete
+		atomic< uint64_t > published;
+	};
+	
+	// 2 * frame + 1 while frame is written to the slot, 2 * frame + 2 once
+	// it is complete
+	struct Slot
+	{
+		atomic< uint64_t > sequence;
+		Frame frame;
+	};
+	
+	static_assert( sizeof( atomic< uint64_t > ) == 8, "the header layout is shared between processes" );
+	
+	void difference( const Combinations &before, const Combinations &after, Frame &frame )
+	{
+		// sets of before that reappear unchanged in after are matched once
+		uint64_t matched[ ( Rules::tiles / 3 + 63 ) / 64 ] = {};
+		auto same = []( const Set &a, const Set &b )
+		{
+			return a.size() == b.size() && equal( a.begin(), a.end(), b.begin() );
+		};
+		
+		frame.addedBytes = 0;
+		for ( auto &set : after )
+		{
+			bool found = false;
+			for ( size_t i = 0; i < before.size() && !found; ++i )
+			{
+				if ( !( matched[ i / 64 ] >> i % 64 & 1 ) && same( before[ i ], set ) )
+				{
+					matched[ i / 64 ] |= uint64_t( 1 ) << i % 64;
+					found = true;
+				}
+			}
+			if ( !found )
+			{
+				for ( auto t : set )
+				{
+					frame.added[ frame.addedBytes++ ] = t.id();
+				}
+				frame.added[ frame.addedBytes++ ] = 0;
+			}
+		}
+		
+		frame.removedSets = 0;
+		for ( size_t i = 0; i < before.size(); ++i )
+		{
+			if ( !( matched[ i / 64 ] >> i % 64 & 1 ) )
+			{
+				frame.removed[ frame.removedSets++ ] = i;
+			}
+		}
+		frame.fieldSets = after.size();
+	}
+}
+
+FeedWriter::FeedWriter( const string &path, size_t slots ) :
+	header_( nullptr ),
+	slots_( nullptr ),
+	mapped_( sizeof( feed::Header ) + slots * sizeof( feed::Slot ) ),
+	next_( 0 )
+{
+	const int fd = open( path.c_str(), O_RDWR | O_CREAT, 0644 );
+	if ( fd < 0 )
+	{
+		throw runtime_error( "could not open feed: " + path );
+	}
+	
+	// readers of an earlier run see the count go back and start over
+	void *p = nullptr;
+	if ( ftruncate( fd, mapped_ ) == 0 )
+	{
+		p = map( fd, mapped_, true );
+	}
+	close( fd );
+	if ( !p )
+	{
+		throw runtime_error( "could not map feed: " + path );
+	}
+	
+	header_ = static_cast< feed::Header* >( p );
+	slots_ = reinterpret_cast< feed::Slot* >( header_ + 1 );
+	
+	header_->published.store( 0, memory_order_release );
+	for ( size_t i = 0; i < slots; ++i )
+	{
+		slots_[ i ].sequence.store( 0, memory_order_relaxed );
+	}
+	memcpy( header_->magic, magic, 4 );
+	header_->version = version;
+	header_->ids = Rules::ids;
+	header_->slots = slots;
+	header_->frameSize = sizeof( feed::Frame );
+}
+
+FeedWriter::~FeedWriter()
+{
+	munmap( header_, mapped_ );
+}
+
+void FeedWriter::publish( const feed::Frame &frame )
+{
+	auto &slot = slots_[ next_ % header_->slots ];
+	
+	slot.sequence.store( 2 * next_ + 1, memory_order_relaxed );
+	atomic_thread_fence( memory_order_release );
+	memcpy( &slot.frame, &frame, sizeof( frame ) );
+	slot.sequence.store( 2 * next_ + 2, memory_order_release );
+	
+	header_->published.store( ++next_, memory_order_release );
+}
+
+FeedReader::FeedReader( const string &path ) :
+	header_( nullptr ),
+	slots_( nullptr ),
+	mapped_( 0 ),
+	cursor_( 0 ),
+	dropped_( 0 )
+{
+	const int fd = open( path.c_str(), O_RDONLY );
+	if ( fd < 0 )
+	{
+		throw runtime_error( "could not open feed: " + path );
+	}
+	
+	struct stat info;
+	void *p = nullptr;
+	if ( fstat( fd, &info ) == 0 && size_t( info.st_size ) >= sizeof( feed::Header ) )
+	{
+		mapped_ = info.st_size;
+		p = map( fd, mapped_, false );
+	}
+	close( fd );
+	if ( !p )
+	{
+		throw runtime_error( "could not map feed: " + path );
+	}
+	
+	header_ = static_cast< const feed::Header* >( p );
+	if ( memcmp( header_->magic, magic, 4 ) != 0 ||
+		header_->version != version ||
+		header_->ids != Rules::ids ||
+		header_->frameSize != sizeof( feed::Frame ) ||
+		mapped_ < sizeof( feed::Header ) + header_->slots * sizeof( feed::Slot ) )
+	{
+		munmap( const_cast< feed::Header* >( header_ ), mapped_ );
+		throw runtime_error( "not a feed for this build: " + path );
+	}
+	slots_ = reinterpret_cast< const feed::Slot* >( header_ + 1 );
+	cursor_ = header_->published.load( memory_order_acquire );
+}
+
+FeedReader::~FeedReader()
+{
+	munmap( const_cast< feed::Header* >( header_ ), mapped_ );
+}
+
+bool FeedReader::next( feed::Frame &frame )
+{
+	const uint64_t slots = header_->slots;
+	for ( ;; )
+	{
+		const uint64_t published = header_->published.load( memory_order_acquire );
+		if ( published < cursor_ )
+		{
+			// the writer was restarted
+			cursor_ = 0;
+			continue;
+		}
+		if ( published == cursor_ )
+		{
+			return false;
+		}
+		if ( published - cursor_ > slots )
+		{
+			dropped_ += published - cursor_ - slots;
+			cursor_ = published - slots;
+		}
+		
+		const auto &slot = slots_[ cursor_ % slots ];
+		const uint64_t expected = 2 * cursor_ + 2;
+		const uint64_t before = slot.sequence.load( memory_order_acquire );
+		memcpy( &frame, &slot.frame, sizeof( frame ) );
+		atomic_thread_fence( memory_order_acquire );
+		const uint64_t after = slot.sequence.load( memory_order_relaxed );
+		
+		++cursor_;
+		if ( before == expected && after == expected )
+		{
+			return true;
+		}
+		
+		// lapped by the writer while copying
+		++dropped_;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "tile.h"
+
+// live turn by turn feed of a server for local spectators, a ring of fixed
+// size frames in a shared mapping (use a file in /dev/shm). there is a single
+// writer that never waits: every slot carries a sequence number that is odd
+// while the slot is written, readers copy a frame and check the number did
+// not change. a reader that falls more than a ring behind skips ahead and
+// counts the frames it missed, so slow readers drop frames instead of
+// holding the game up
+namespace feed
+{
+	struct Frame
+	{
+		uint32_t game;          // games started by this writer
+		uint32_t move;          // move within the game
+		uint8_t player;         // 0 based seat
+		uint8_t placed;         // tiles put down from the hand, 0 for a draw
+		uint8_t finished;       // 1 on the last move of a game
+		uint8_t removedSets;    // entries used in removed
+		uint16_t pool;          // tiles left in the pool after the move
+		uint16_t hand;          // tiles left in the hand of player
+		uint16_t fieldSets;     // sets on the field after the move
+		uint16_t addedBytes;    // bytes used in added
+		
+		// indices of the sets of the previous field the move replaced, a
+		// field has at most one set per three tiles
+		uint8_t removed[ Rules::tiles / 3 ];
+		
+		// tile ids of every set the move put down, each set ends with a 0
+		uint8_t added[ Rules::tiles + Rules::tiles / 3 ];
+	};
+	
+	static_assert( Rules::tiles / 3 < 256, "set indices are stored in a byte" );
+	
+	struct Header;
+	struct Slot;
+	
+	// what changed from before to after: the sets of before that are not in
+	// after and the sets of after that are not in before, both as multisets
+	void difference( const Combinations &before, const Combinations &after, Frame &frame );
+}
+
+class FeedWriter
+{
+	public:
+		
+		// creates or resets the feed at path with room for slots frames
+		explicit FeedWriter( const std::string &path, size_t slots = 1024 );
+		~FeedWriter();
+		
+		FeedWriter( const FeedWriter& ) = delete;
+		FeedWriter& operator = ( const FeedWriter& ) = delete;
+		
+		void publish( const feed::Frame &frame );
+		
+	private:
+		
+		feed::Header *header_;
+		feed::Slot *slots_;
+		size_t mapped_;
+		uint64_t next_;
+};
+
+class FeedReader
+{
+	public:
+		
+		// attaches to an existing feed, the first frame read is the next one
+		// published
+		explicit FeedReader( const std::string &path );
+		~FeedReader();
+		
+		FeedReader( const FeedReader& ) = delete;
+		FeedReader& operator = ( const FeedReader& ) = delete;
+		
+		// copies the next frame, false when there is none yet
+		bool next( feed::Frame &frame );
+		
+		// frames that were overwritten before they could be read
+		uint64_t dropped() const
+		{
+			return dropped_;
+		}
+		
+	private:
+		
+		const feed::Header *header_;
+		const feed::Slot *slots_;
+		size_t mapped_;
+		uint64_t cursor_;
+		uint64_t dropped_;
+};
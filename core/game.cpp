@@ -0,0 +1,439 @@
+#include "game.h"
+#include "validate.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+	// counter based generator: the counter-th number of the stream of key is
+	// a hash of both, so any part of a stream is computed without the rest.
+	// the rounds are the splitmix64 finalizer
+	uint64_t random( uint64_t key, uint64_t counter )
+	{
+		uint64_t x = key * 0x9e3779b97f4a7c15ull + ( counter + 1 ) * 0xd1b54a32d192ed03ull;
+		for ( int round = 0; round < 2; ++round )
+		{
+			x = ( x ^ x >> 30 ) * 0xbf58476d1ce4e5b9ull;
+			x = ( x ^ x >> 27 ) * 0x94d049bb133111ebull;
+			x ^= x >> 31;
+		}
+		return x;
+	}
+}
+
+Tiles init_tiles( uint64_t seed )
+{
+	Tiles result;
+	result.reserve( Rules::tiles );
+	
+	for ( size_t i = 0; i < Rules::copies; ++i )
+	{
+		for ( size_t num = 1; num <= Rules::numbers; ++num )
+		{
+			for ( size_t col = 0; col < Rules::colors; ++col )
+			{
+				result.push_back( Tile::fromValue( num, col ) );
+			}
+		}
+	}
+	result.insert( result.end(), Rules::jokers, Tile::joker() );
+	
+	// fisher yates with the i-th number of the stream of seed, scaled to
+	// 0..i by a multiply instead of a division
+	for ( size_t i = result.size(); i-- > 1; )
+	{
+		const auto j = ( random( seed, i ) >> 32 ) * ( i + 1 ) >> 32;
+		swap( result[ i ], result[ j ] );
+	}
+	
+	return result;
+}
+
+vector< Tiles > deal( Tiles &pool, size_t players )
+{
+	vector< Tiles > hands( players );
+	auto start = pool.begin();
+	for ( auto &hand : hands )
+	{
+		const auto end = start + min< size_t >( Rules::hand, pool.end() - start );
+		hand.assign( start, end );
+		start = end;
+	}
+	pool.erase( pool.begin(), start );
+	return hands;
+}
+
+Hand::Hand( const Tiles &tiles ) :
+	Hand()
+{
+	for ( auto t : tiles )
+	{
+		add( t );
+	}
+}
+
+Tiles Hand::tiles() const
+{
+	Tiles result;
+	result.reserve( size_ );
+	for ( size_t id = 0; id < counts_.size(); ++id )
+	{
+		for ( size_t i = 0; i < counts_[ id ]; ++i )
+		{
+			result.push_back( Tile::fromId( id ) );
+		}
+	}
+	return result;
+}
+
+size_t Hand::points() const
+{
+	size_t total = 0;
+	for ( size_t id = 0; id < counts_.size(); ++id )
+	{
+		total += counts_[ id ] * tile::Table< Rules >::values[ id ];
+	}
+	return total + counts_[ tile::joker ] * tile::jokerPoints;
+}
+
+namespace
+{
+	// adds t when the hand holds it and the set stays valid with it
+	RUMMIKUB_KERNEL
+	bool tryAdd( Set &set, Hand &hand, Tile t )
+	{
+		if ( !hand.count( t ) || set.size() == Set::capacity() )
+		{
+			return false;
+		}
+		set.push_back( t );
+		if ( !setIsValid( set ) )
+		{
+			set.pop_back();
+			return false;
+		}
+		hand.remove( t );
+		return true;
+	}
+}
+
+RUMMIKUB_KERNEL
+bool extend( Set &set, Hand &hand )
+{
+	const size_t size = set.size();
+	
+	uint32_t mask = 0;
+	for ( auto t : set )
+	{
+		mask |= t;
+	}
+	
+	// the jokers are left out of the mask, so a set that holds them still
+	// shows a single color or a single number
+	if ( hamming_weight( mask & Rules::colorMask ) == 1 )
+	{
+		const size_t color = lowest_bit( mask & Rules::colorMask );
+		for ( bool grown = true; grown; )
+		{
+			grown = false;
+			for ( size_t n = 1; n <= Rules::numbers; ++n )
+			{
+				const auto t = Tile::fromValue( n, color );
+				if ( !( mask & t ) && tryAdd( set, hand, t ) )
+				{
+					mask |= t;
+					grown = true;
+				}
+			}
+		}
+	}
+	
+	if ( hamming_weight( mask & Rules::numberMask ) == 1 )
+	{
+		const size_t number = lowest_bit( mask & Rules::numberMask ) - Rules::colors + 1;
+		for ( size_t c = 0; c < Rules::colors; ++c )
+		{
+			const auto t = Tile::fromValue( number, c );
+			if ( !( mask & t.color() ) && tryAdd( set, hand, t ) )
+			{
+				mask |= t;
+			}
+		}
+	}
+	
+	while ( tryAdd( set, hand, Tile::joker() ) );
+	
+	if ( set.size() == size )
+	{
+		return false;
+	}
+	sort( set );
+	return true;
+}
+
+const char* describe( MoveError error )
+{
+	switch ( error )
+	{
+		case MoveError::none:
+			return "no error";
+		case MoveError::finished:
+			return "game is finished";
+		case MoveError::badIndex:
+			return "removed set does not exist";
+		case MoveError::invalidSet:
+			return "invalid set";
+		case MoveError::tileRemoved:
+			return "tiles removed from field";
+		case MoveError::notOwned:
+			return "tile was not owned";
+		case MoveError::nothingPlaced:
+			return "no tiles placed";
+	}
+	return "unknown error";
+}
+
+GameState::GameState( Tiles pool, const vector< Tiles > &hands, Combinations field ) :
+	pool_( move( pool ) ),
+	hands_( hands.begin(), hands.end() ),
+	field_( move( field ) ),
+	current_( 0 ),
+	passes_( 0 ),
+	delta_()
+{
+	const size_t tiles = pool_.size() + Rules::tiles;
+	journal_.reserve( tiles );
+	placed_.reserve( tiles );
+	removedSets_.reserve( tiles );
+	removedAt_.reserve( tiles );
+}
+
+void GameState::reset( const Tiles &pool, const vector< Tiles > &hands, const Combinations &field )
+{
+	pool_.assign( pool.begin(), pool.end() );
+	hands_.resize( hands.size() );
+	for ( size_t i = 0; i < hands.size(); ++i )
+	{
+		hands_[ i ] = Hand( hands[ i ] );
+	}
+	field_.assign( field.begin(), field.end() );
+	current_ = 0;
+	passes_ = 0;
+	
+	journal_.clear();
+	removedSets_.clear();
+	removedAt_.clear();
+	placed_.clear();
+}
+
+bool GameState::finished() const
+{
+	for ( auto &h : hands_ )
+	{
+		if ( h.empty() )
+		{
+			return true;
+		}
+	}
+	return pool_.empty() && passes_ >= hands_.size();
+}
+
+RUMMIKUB_KERNEL
+MoveError GameState::check( const Move &move ) const
+{
+	if ( finished() )
+	{
+		return MoveError::finished;
+	}
+	
+	if ( move.draw() )
+	{
+		return MoveError::none;
+	}
+	
+	for ( size_t i = 0; i < move.removed.size(); ++i )
+	{
+		if ( move.removed[ i ] >= field_.size() || ( i && move.removed[ i ] <= move.removed[ i - 1 ] ) )
+		{
+			return MoveError::badIndex;
+		}
+	}
+	
+	for ( auto &set : move.added )
+	{
+		if ( !setIsValid( set ) )
+		{
+			return MoveError::invalidSet;
+		}
+	}
+	
+	for ( auto &set : move.added )
+	{
+		for ( auto t : set )
+		{
+			++delta_[ t.id() ];
+		}
+	}
+	for ( auto i : move.removed )
+	{
+		for ( auto t : field_[ i ] )
+		{
+			--delta_[ t.id() ];
+		}
+	}
+	
+	// every id is inspected once, by the first tile that sees it non zero,
+	// and reset so the scratch space is clean whatever the outcome
+	auto result = MoveError::none;
+	size_t placed = 0;
+	auto inspect = [&]( Tile t )
+	{
+		const int d = delta_[ t.id() ];
+		if ( d < 0 )
+		{
+			result = MoveError::tileRemoved;
+		}
+		else if ( d > 0 )
+		{
+			if ( hands_[ current_ ].count( t ) < size_t( d ) && result == MoveError::none )
+			{
+				result = MoveError::notOwned;
+			}
+			placed += d;
+		}
+		delta_[ t.id() ] = 0;
+	};
+	for ( auto &set : move.added )
+	{
+		for_each( set.begin(), set.end(), inspect );
+	}
+	for ( auto i : move.removed )
+	{
+		for_each( field_[ i ].begin(), field_[ i ].end(), inspect );
+	}
+	
+	if ( result == MoveError::none && !placed )
+	{
+		result = MoveError::nothingPlaced;
+	}
+	
+	return result;
+}
+
+MoveError GameState::apply( const Move &move )
+{
+	const auto error = check( move );
+	if ( error != MoveError::none )
+	{
+		return error;
+	}
+	
+	Record record { uint8_t( current_ ), Tile(), 0, 0, 0, uint8_t( passes_ ) };
+	auto &hand = hands_[ current_ ];
+	
+	if ( move.draw() )
+	{
+		if ( pool_.empty() )
+		{
+			++passes_;
+		}
+		else
+		{
+			record.drawn = pool_.back();
+			pool_.pop_back();
+			hand.add( record.drawn );
+			passes_ = 0;
+		}
+	}
+	else
+	{
+		for ( auto &set : move.added )
+		{
+			for ( auto t : set )
+			{
+				++delta_[ t.id() ];
+			}
+		}
+		
+		// highest index first, the set that takes the place of a removed one
+		// comes from the back and is never one that still has to go
+		for ( auto i = move.removed.rbegin(); i != move.removed.rend(); ++i )
+		{
+			for ( auto t : field_[ *i ] )
+			{
+				--delta_[ t.id() ];
+			}
+			removedAt_.push_back( uint8_t( *i ) );
+			removedSets_.push_back( field_[ *i ] );
+			field_[ *i ] = field_.back();
+			field_.pop_back();
+			++record.removed;
+		}
+		
+		for ( auto &set : move.added )
+		{
+			for ( auto t : set )
+			{
+				if ( delta_[ t.id() ] > 0 )
+				{
+					--delta_[ t.id() ];
+					hand.remove( t );
+					placed_.push_back( t );
+					++record.placed;
+				}
+			}
+			field_.push_back( set );
+			++record.added;
+		}
+		
+		passes_ = 0;
+	}
+	
+	journal_.push_back( record );
+	current_ = ( current_ + 1 ) % hands_.size();
+	
+	return MoveError::none;
+}
+
+void GameState::undo()
+{
+	const auto record = journal_.back();
+	journal_.pop_back();
+	
+	auto &hand = hands_[ record.player ];
+	
+	if ( record.drawn.valid() )
+	{
+		hand.remove( record.drawn );
+		pool_.push_back( record.drawn );
+	}
+	
+	field_.resize( field_.size() - record.added );
+	
+	for ( size_t i = 0; i < record.removed; ++i )
+	{
+		const size_t at = removedAt_.back();
+		if ( at == field_.size() )
+		{
+			field_.push_back( removedSets_.back() );
+		}
+		else
+		{
+			field_.push_back( field_[ at ] );
+			field_[ at ] = removedSets_.back();
+		}
+		removedAt_.pop_back();
+		removedSets_.pop_back();
+	}
+	
+	for ( size_t i = 0; i < record.placed; ++i )
+	{
+		hand.add( placed_.back() );
+		placed_.pop_back();
+	}
+	
+	current_ = record.player;
+	passes_ = record.passes;
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "tile.h"
+
+// every tile of the variant, shuffled by a counter based generator keyed
+// with seed. every seed is its own stream, so the deal of any game is made
+// directly from its number and disjoint seed ranges give disjoint games
+Tiles init_tiles( uint64_t seed = 0 );
+
+// the hands of players, Rules::hand tiles each taken in seat order from the
+// front of pool. the tiles left are drawn from its back, so every mode that
+// deals with this plays the same game for the same seed
+std::vector< Tiles > deal( Tiles &pool, size_t players );
+
+// multiset of tiles indexed by tile id, membership tests and updates are O(1)
+class Hand
+{
+	public:
+		
+		Hand() :
+			counts_(),
+			size_( 0 ) {}
+		
+		explicit Hand( const Tiles &tiles );
+		
+		size_t count( Tile t ) const
+		{
+			return counts_[ t.id() ];
+		}
+		
+		size_t size() const
+		{
+			return size_;
+		}
+		
+		bool empty() const
+		{
+			return size_ == 0;
+		}
+		
+		void add( Tile t )
+		{
+			++counts_[ t.id() ];
+			++size_;
+		}
+		
+		void remove( Tile t )
+		{
+			--counts_[ t.id() ];
+			--size_;
+		}
+		
+		const std::array< uint8_t, Rules::ids >& counts() const
+		{
+			return counts_;
+		}
+		
+		// the tiles in sorted order
+		Tiles tiles() const;
+		
+		size_t points() const;
+		
+	private:
+		std::array< uint8_t, Rules::ids > counts_;
+		size_t size_;
+};
+
+// grows a valid set with tiles from the hand, numbers of a run's color or
+// colors of a group's number and then jokers, as long as it stays valid. the
+// set is sorted afterwards, true when it changed
+bool extend( Set &set, Hand &hand );
+
+// a turn expressed as a change to the field. an empty move draws a tile
+struct Move
+{
+	// field indices of the sets that are taken apart, in ascending order
+	std::vector< size_t > removed;
+	
+	// sets put on the field, made from the removed tiles plus tiles from the hand
+	std::vector< Set > added;
+	
+	bool draw() const
+	{
+		return removed.empty() && added.empty();
+	}
+	
+	void clear()
+	{
+		removed.clear();
+		added.clear();
+	}
+};
+
+enum class MoveError
+{
+	none,
+	finished,       // the game is already over
+	badIndex,       // a removed set does not exist or is listed twice
+	invalidSet,     // an added set is not a run or a group
+	tileRemoved,    // a tile taken from the field is not put back
+	notOwned,       // the player does not hold a tile that is placed
+	nothingPlaced   // the field changes without a tile from the hand
+};
+
+const char* describe( MoveError error );
+
+// pool, hands and field of a game, moves are applied and undone in place in
+// O(changed tiles) so search code can explore lines without copying state.
+// not thread safe, check() uses internal scratch space
+class GameState
+{
+	public:
+		
+		GameState( Tiles pool, const std::vector< Tiles > &hands, Combinations field = Combinations() );
+		
+		// starts over from another position, keeping the memory of this one
+		void reset( const Tiles &pool, const std::vector< Tiles > &hands, const Combinations &field );
+		
+		size_t players() const
+		{
+			return hands_.size();
+		}
+		
+		// the player whose turn it is
+		size_t current() const
+		{
+			return current_;
+		}
+		
+		const Hand& hand( size_t player ) const
+		{
+			return hands_[ player ];
+		}
+		
+		const Tiles& pool() const
+		{
+			return pool_;
+		}
+		
+		const Combinations& field() const
+		{
+			return field_;
+		}
+		
+		// moves applied and not undone
+		size_t depth() const
+		{
+			return journal_.size();
+		}
+		
+		// a player ran out of tiles, or the pool is empty and every player
+		// passed since the last tile was placed
+		bool finished() const;
+		
+		MoveError check( const Move &move ) const;
+		
+		// applies the move for the current player and hands the turn to the
+		// next one. an invalid move leaves the state untouched
+		MoveError apply( const Move &move );
+		
+		// reverts the last applied move
+		void undo();
+		
+	private:
+		
+		struct Record
+		{
+			uint8_t player;
+			Tile drawn;
+			uint8_t removed;
+			uint8_t added;
+			uint16_t placed;
+			uint8_t passes;
+		};
+		
+		Tiles pool_;
+		std::vector< Hand > hands_;
+		Combinations field_;
+		size_t current_;
+		size_t passes_;
+		
+		std::vector< Record > journal_;
+		std::vector< Set > removedSets_;
+		std::vector< uint8_t > removedAt_;
+		Tiles placed_;
+		
+		// per tile id difference between added and removed tiles, all zero
+		// outside of check() and apply()
+		mutable std::array< int8_t, Rules::ids > delta_;
+};
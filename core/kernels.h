@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// the bit helpers below are inline and built for the baseline cpu, where a
+// popcount takes a dozen instructions. the hot paths that use them, set
+// validation, extending sets and the bitboard move generators, are marked
+// RUMMIKUB_KERNEL instead: the compiler builds them once per instruction set
+// (baseline, POPCNT, and Haswell with BMI2 and LZCNT) with the helpers
+// inlined into every clone, and the loader picks the best one the cpu
+// supports when the program starts
+#if defined( __x86_64__ ) && defined( __linux__ ) && defined( __has_attribute )
+#if __has_attribute( target_clones )
+#define RUMMIKUB_KERNEL __attribute__(( target_clones( "default", "popcnt", "arch=haswell" ) ))
+#endif
+#endif
+
+#ifndef RUMMIKUB_KERNEL
+#define RUMMIKUB_KERNEL
+#endif
+
+inline uint32_t hamming_weight( uint32_t n )
+{
+	return __builtin_popcount( n );
+}
+
+// index of the highest set bit, v must not be zero
+inline uint32_t highest_bit( uint32_t v )
+{
+	return 31 - __builtin_clz( v );
+}
+
+// index of the lowest set bit, v must not be zero
+inline uint32_t lowest_bit( uint32_t v )
+{
+	return __builtin_ctz( v );
+}
@@ -0,0 +1,224 @@
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "validate.h"
+
+using namespace std;
+
+namespace
+{
+	// what the kernels compute, written out bit by bit
+	uint32_t countScalar( uint32_t v )
+	{
+		uint32_t n = 0;
+		for ( ; v; v >>= 1 )
+		{
+			n += v & 1;
+		}
+		return n;
+	}
+	
+	uint32_t highestScalar( uint32_t v )
+	{
+		uint32_t i = 0;
+		while ( v >>= 1 )
+		{
+			++i;
+		}
+		return i;
+	}
+	
+	uint32_t lowestScalar( uint32_t v )
+	{
+		uint32_t i = 0;
+		for ( ; !( v & 1 ); v >>= 1 )
+		{
+			++i;
+		}
+		return i;
+	}
+	
+	// a run of one color and distinct numbers that the jokers can close up,
+	// or a group of one number and distinct colors
+	bool validScalar( const Set &set )
+	{
+		if ( set.size() < 3 )
+		{
+			return false;
+		}
+		
+		vector< Tile > numbered;
+		for ( auto t : set )
+		{
+			if ( !t.isJoker() )
+			{
+				numbered.push_back( t );
+			}
+		}
+		if ( numbered.empty() )
+		{
+			return set.size() <= Rules::setSize;
+		}
+		
+		bool run = set.size() <= Rules::numbers, group = set.size() <= Rules::colors;
+		size_t low = Rules::numbers, high = 0;
+		for ( size_t i = 0; i < numbered.size(); ++i )
+		{
+			const auto t = numbered[ i ];
+			low = min( low, t.value() );
+			high = max( high, t.value() );
+			run = run && t.colorIndex() == numbered[ 0 ].colorIndex();
+			group = group && t.value() == numbered[ 0 ].value();
+			for ( size_t j = 0; j < i; ++j )
+			{
+				run = run && numbered[ j ].value() != t.value();
+				group = group && numbered[ j ].colorIndex() != t.colorIndex();
+			}
+		}
+		return group || ( run && high - low + 1 <= set.size() );
+	}
+	
+	struct Input
+	{
+		vector< uint32_t > words;
+		vector< Set > sets;
+	};
+	
+	// every result of the kernels in a row, inlined into each build below
+	__attribute__(( always_inline )) inline vector< uint32_t > results( const Input &input )
+	{
+		vector< uint32_t > out;
+		for ( auto w : input.words )
+		{
+			out.push_back( hamming_weight( w ) );
+			if ( w )
+			{
+				out.push_back( highest_bit( w ) );
+				out.push_back( lowest_bit( w ) );
+			}
+		}
+		for ( auto &set : input.sets )
+		{
+			out.push_back( setIsValid( set ) );
+		}
+		return out;
+	}
+	
+	vector< uint32_t > resultsScalar( const Input &input )
+	{
+		vector< uint32_t > out;
+		for ( auto w : input.words )
+		{
+			out.push_back( countScalar( w ) );
+			if ( w )
+			{
+				out.push_back( highestScalar( w ) );
+				out.push_back( lowestScalar( w ) );
+			}
+		}
+		for ( auto &set : input.sets )
+		{
+			out.push_back( validScalar( set ) );
+		}
+		return out;
+	}
+	
+	vector< uint32_t > resultsDefault( const Input &input )
+	{
+		return results( input );
+	}
+	
+#if defined( __x86_64__ )
+	__attribute__(( target( "popcnt" ) ))
+	vector< uint32_t > resultsPopcnt( const Input &input )
+	{
+		return results( input );
+	}
+	
+	// the instruction sets of the arch=haswell clone, inlining needs them
+	// spelled out
+	__attribute__(( target( "popcnt,avx2,bmi,bmi2,lzcnt,fma" ) ))
+	vector< uint32_t > resultsHaswell( const Input &input )
+	{
+		return results( input );
+	}
+#endif
+	
+	struct Build
+	{
+		const char *name;
+		vector< uint32_t > ( *results )( const Input& );
+	};
+	
+	// the builds of RUMMIKUB_KERNEL that this cpu can run
+	vector< Build > builds()
+	{
+		vector< Build > result { { "default", resultsDefault } };
+#if defined( __x86_64__ )
+		__builtin_cpu_init();
+		if ( __builtin_cpu_supports( "popcnt" ) )
+		{
+			result.push_back( { "popcnt", resultsPopcnt } );
+		}
+		if ( __builtin_cpu_is( "haswell" ) || ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "bmi2" ) && __builtin_cpu_supports( "fma" ) ) )
+		{
+			result.push_back( { "haswell", resultsHaswell } );
+		}
+#endif
+		return result;
+	}
+}
+
+// every build of the kernels against the scalar versions, on sparse, dense
+// and uniform words and on random sets that are mostly close to valid
+int main()
+{
+	mt19937 random( 1 );
+	Input input;
+	for ( size_t i = 0; i < 30000; ++i )
+	{
+		const uint32_t r = random();
+		input.words.push_back( i % 3 == 0 ? r & random() & random() : i % 3 == 1 ? r | random() : r );
+	}
+	input.words.push_back( 0 );
+	input.words.push_back( ~0u );
+	
+	for ( size_t i = 0; i < 30000; ++i )
+	{
+		Set set;
+		const size_t size = random() % ( Set::capacity() + 1 );
+		const size_t color = random() % Rules::colors, number = random() % Rules::numbers + 1;
+		for ( size_t k = 0; k < size; ++k )
+		{
+			const auto pick = random() % 8;
+			if ( pick == 0 )
+			{
+				set.push_back( Tile::joker() );
+			}
+			else if ( pick < 4 && number + k <= Rules::numbers )
+			{
+				set.push_back( Tile::fromValue( number + k, color ) );
+			}
+			else if ( pick < 7 )
+			{
+				set.push_back( Tile::fromValue( number, ( color + k ) % Rules::colors ) );
+			}
+			else
+			{
+				set.push_back( Tile::fromValue( random() % Rules::numbers + 1, random() % Rules::colors ) );
+			}
+		}
+		input.sets.push_back( set );
+	}
+	
+	const auto expected = resultsScalar( input );
+	size_t failures = 0;
+	for ( auto &build : builds() )
+	{
+		const bool same = build.results( input ) == expected;
+		cout << build.name << ( same ? " ok\n" : " differs from scalar\n" );
+		failures += !same;
+	}
+	return failures ? 1 : 0;
+}
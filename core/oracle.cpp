@@ -0,0 +1,312 @@
+#include "oracle.h"
+#include "validate.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+
+using namespace std;
+
+namespace
+{
+	static_assert( Rules::colors * Rules::copies * 2 <= 64, "every run slot needs two bits of a 64 bit state" );
+	static_assert( Rules::jokers < 16 && Rules::colors * Rules::copies < 64, "joker and group counts are packed into the state" );
+	
+	const size_t copies = Rules::copies;
+	const size_t colorBits = copies * 2;
+	const uint64_t colorMask = ( uint64_t( 1 ) << colorBits ) - 1;
+	const int empty = INT_MIN;
+	
+	// the run slots of a color, sorted so equivalent states share a key
+	uint32_t pack( array< uint32_t, Rules::copies > slots )
+	{
+		sort( slots.begin(), slots.end() );
+		uint32_t packed = 0;
+		for ( size_t k = 0; k < copies; ++k )
+		{
+			packed |= slots[ k ] << ( k * 2 );
+		}
+		return packed;
+	}
+	
+	// for the slots of a color and the number of its tiles that go into runs,
+	// every distinct way to continue: the chosen slots grow (3 stands for
+	// three and more) and the others end their run, which needs three tiles
+	struct Transitions
+	{
+		array< array< vector< uint32_t >, Rules::copies + 1 >, 1u << colorBits > next;
+		
+		Transitions()
+		{
+			for ( uint32_t packed = 0; packed < next.size(); ++packed )
+			{
+				array< uint32_t, Rules::copies > slots;
+				for ( size_t k = 0; k < copies; ++k )
+				{
+					slots[ k ] = packed >> ( k * 2 ) & 3;
+				}
+				
+				for ( uint32_t extend = 0; extend < 1u << copies; ++extend )
+				{
+					array< uint32_t, Rules::copies > after;
+					bool valid = true;
+					for ( size_t k = 0; k < copies; ++k )
+					{
+						if ( extend >> k & 1 )
+						{
+							after[ k ] = min( slots[ k ] + 1, 3u );
+						}
+						else
+						{
+							valid = valid && ( slots[ k ] == 0 || slots[ k ] == 3 );
+							after[ k ] = 0;
+						}
+					}
+					
+					auto &list = next[ packed ][ hamming_weight( extend ) ];
+					const auto result = pack( after );
+					if ( valid && find( list.begin(), list.end(), result ) == list.end() )
+					{
+						list.push_back( result );
+					}
+				}
+			}
+		}
+	};
+	
+	const Transitions& transitions()
+	{
+		static const Transitions table;
+		return table;
+	}
+	
+	// extra holds the jokers spent so far and the group tiles of the current
+	// number, their sum and the most of a single color
+	uint32_t extra( uint32_t jokers, uint32_t sum, uint32_t most )
+	{
+		return jokers | sum << 4 | most << 10;
+	}
+	
+	// g_c tiles per color form groups of three or more distinct colors when
+	// there are enough of them for some number of groups that no color has
+	// more tiles than, dealing them round robin then fills every group
+	bool groupsFit( uint32_t sum, uint32_t most )
+	{
+		if ( sum == 0 )
+		{
+			return true;
+		}
+		for ( uint32_t groups = max( most, 1u ); groups <= copies; ++groups )
+		{
+			if ( sum >= 3 * groups )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	// whether the runs of a color that are still too short can get the
+	// tiles they need from the next two numbers
+	bool reachable( uint32_t runs, uint32_t next, uint32_t afterNext )
+	{
+		uint32_t short1 = 0, short2 = 0;
+		for ( size_t k = 0; k < copies; ++k )
+		{
+			const auto length = runs >> ( k * 2 ) & 3;
+			short1 += length == 1;
+			short2 += length == 1 || length == 2;
+		}
+		return short2 <= next && short1 <= afterNext;
+	}
+	
+	size_t slot( const uint64_t runs, uint32_t extra, size_t capacity )
+	{
+		return ( ( runs ^ ( uint64_t( extra ) << 40 ) ) * 0x9e3779b97f4a7c15ull >> 20 ) & ( capacity - 1 );
+	}
+}
+
+void Oracle::Layer::clear()
+{
+	for ( auto i : used_ )
+	{
+		values_[ i ].tiles = empty;
+	}
+	used_.clear();
+}
+
+void Oracle::Layer::update( const State &state, Value value )
+{
+	if ( ( used_.size() + 1 ) * 2 > states_.size() )
+	{
+		grow();
+	}
+	
+	for ( size_t i = slot( state.runs, state.extra, states_.size() ); ; i = ( i + 1 ) & ( states_.size() - 1 ) )
+	{
+		if ( values_[ i ].tiles == empty )
+		{
+			states_[ i ] = state;
+			values_[ i ] = value;
+			used_.push_back( i );
+			return;
+		}
+		if ( states_[ i ] == state )
+		{
+			values_[ i ].tiles = max( values_[ i ].tiles, value.tiles );
+			values_[ i ].points = max( values_[ i ].points, value.points );
+			return;
+		}
+	}
+}
+
+void Oracle::Layer::grow()
+{
+	vector< State > states;
+	vector< Value > values;
+	for ( size_t i = 0; i < used_.size(); ++i )
+	{
+		states.push_back( state( i ) );
+		values.push_back( value( i ) );
+	}
+	
+	const size_t capacity = max< size_t >( states_.size() * 2, 1024 );
+	states_.assign( capacity, State() );
+	values_.assign( capacity, Value { empty, empty } );
+	used_.clear();
+	for ( size_t i = 0; i < states.size(); ++i )
+	{
+		update( states[ i ], values[ i ] );
+	}
+}
+
+Placement Oracle::best( const Hand &hand, const Hand &field )
+{
+	// late in a game the whole hand often fits, which is cheap to find out
+	// since none of its tiles is optional then
+	const auto all = solve( hand, field, true );
+	if ( all.tiles >= 0 )
+	{
+		return all;
+	}
+	return solve( hand, field, false );
+}
+
+Placement Oracle::solve( const Hand &hand, const Hand &field, bool everything )
+{
+	const auto &table = transitions();
+	const uint32_t fieldJokers = field.count( Tile::joker() );
+	const uint32_t jokers = fieldJokers + hand.count( Tile::joker() );
+	
+	// the most tiles every position can take, a run shorter than three
+	// needs one at each of its next numbers or it is a dead end
+	array< array< uint32_t, Rules::colors >, Rules::numbers + 3 > room {};
+	for ( size_t n = 1; n <= Rules::numbers; ++n )
+	{
+		for ( size_t c = 0; c < Rules::colors; ++c )
+		{
+			const auto t = Tile::fromValue( n, c );
+			room[ n ][ c ] = min< size_t >( field.count( t ) + hand.count( t ) + jokers, copies );
+		}
+	}
+	
+	current_.clear();
+	current_.update( State { 0, 0 }, Value { 0, 0 } );
+	
+	for ( size_t n = 1; n <= Rules::numbers; ++n )
+	{
+		for ( size_t c = 0; c < Rules::colors; ++c )
+		{
+			const auto t = Tile::fromValue( n, c );
+			const size_t onField = field.count( t );
+			const size_t inHand = hand.count( t );
+			if ( onField > copies )
+			{
+				return { -1, -1 };
+			}
+			
+			next_.clear();
+			// group tiles the colors after this one can still add
+			size_t later = 0;
+			for ( size_t d = c + 1; d < Rules::colors; ++d )
+			{
+				later += room[ n ][ d ];
+			}
+			
+			for ( size_t i = 0; i < current_.size(); ++i )
+			{
+				const auto &state = current_.state( i );
+				const auto &next = table.next[ state.runs >> ( c * colorBits ) & colorMask ];
+				const uint64_t others = state.runs & ~( colorMask << ( c * colorBits ) );
+				const uint32_t spent = state.extra & 15;
+				const uint32_t sum = state.extra >> 4 & 63;
+				const uint32_t most = state.extra >> 10;
+				
+				const size_t fewest = everything ? onField + inHand : onField;
+				for ( size_t real = fewest; real <= min( onField + inHand, copies ); ++real )
+				{
+					const auto before = current_.value( i );
+					const Value value { before.tiles + int( real - onField ), before.points + int( ( real - onField ) * n ) };
+					
+					for ( size_t wild = 0; real + wild <= copies && spent + wild <= jokers; ++wild )
+					{
+						const size_t placed = real + wild;
+						for ( size_t group = 0; group <= placed; ++group )
+						{
+							// groups that can no longer get three tiles each are a dead end,
+							// beyond three per copy the sum does not matter any more
+							const uint32_t groups = max< uint32_t >( most, group );
+							if ( sum + group && sum + group + later < 3 * max( groups, 1u ) )
+							{
+								continue;
+							}
+							const uint32_t e = extra( spent + wild, min< uint32_t >( sum + group, 3 * copies ), groups );
+							for ( auto runs : next[ placed - group ] )
+							{
+								if ( !reachable( runs, room[ n + 1 ][ c ], room[ n + 2 ][ c ] ) )
+								{
+									continue;
+								}
+								next_.update( State { others | uint64_t( runs ) << ( c * colorBits ), e }, value );
+							}
+						}
+					}
+				}
+			}
+			swap( current_, next_ );
+		}
+		
+		// the groups of this number are complete
+		next_.clear();
+		for ( size_t i = 0; i < current_.size(); ++i )
+		{
+			const auto &state = current_.state( i );
+			if ( groupsFit( state.extra >> 4 & 63, state.extra >> 10 ) )
+			{
+				next_.update( State { state.runs, extra( state.extra & 15, 0, 0 ) }, current_.value( i ) );
+			}
+		}
+		swap( current_, next_ );
+	}
+	
+	Placement best { -1, -1 };
+	for ( size_t i = 0; i < current_.size(); ++i )
+	{
+		const auto &state = current_.state( i );
+		bool closed = true;
+		for ( size_t k = 0; k < Rules::colors * copies; ++k )
+		{
+			const auto length = state.runs >> ( k * 2 ) & 3;
+			closed = closed && ( length == 0 || length == 3 );
+		}
+		const uint32_t spent = state.extra & 15;
+		if ( closed && spent >= ( everything ? jokers : fieldJokers ) )
+		{
+			const int jokers = spent - fieldJokers;
+			const auto value = current_.value( i );
+			best.tiles = max( best.tiles, value.tiles + jokers );
+			best.points = max( best.points, value.points + jokers * int( tile::jokerPoints ) );
+		}
+	}
+	return best;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "game.h"
+
+// the best a player can do in one turn: every tile of the field has to stay
+// on the field, the sets may be rearranged freely
+struct Placement
+{
+	// most hand tiles that can be put down
+	int tiles;
+	
+	// most points that can be put down, jokers count as tile::jokerPoints
+	int points;
+};
+
+// exact solver for the largest placement, a dynamic program over the numbers
+// in the spirit of van Rijn, Takes and Vis. for every color it keeps one slot
+// per copy holding the length of the run passing through it (0, 1, 2 or 3
+// and more), and every number's tiles either extend runs or go into groups,
+// whose feasibility only depends on the number of tiles per color. jokers
+// are a budget spent on any tile position, so their substitutions are never
+// enumerated. a joker standing in for a tile of which every copy is already
+// placed is not modelled, the result is a lower bound in that rare case.
+// the layers are reused between calls, an Oracle is meant to be kept per thread
+class Oracle
+{
+	public:
+		
+		// field holds the tiles of every set on the field, -1 for both when
+		// even the field on its own cannot be laid out
+		Placement best( const Hand &hand, const Hand &field );
+		
+	private:
+		
+		struct State
+		{
+			uint64_t runs;
+			uint32_t extra;
+			
+			bool operator == ( const State &other ) const
+			{
+				return runs == other.runs && extra == other.extra;
+			}
+		};
+		
+		// the most tiles and the most points that reach a state, both are
+		// maximized on their own over the same transitions
+		struct Value
+		{
+			int tiles;
+			int points;
+		};
+		
+		// open addressing table of the best values of every state, cleared in
+		// time proportional to the states it holds
+		class Layer
+		{
+			public:
+				
+				void clear();
+				void update( const State &state, Value value );
+				
+				size_t size() const
+				{
+					return used_.size();
+				}
+				
+				const State& state( size_t i ) const
+				{
+					return states_[ used_[ i ] ];
+				}
+				
+				Value value( size_t i ) const
+				{
+					return values_[ used_[ i ] ];
+				}
+				
+			private:
+				
+				void grow();
+				
+				std::vector< State > states_;
+				std::vector< Value > values_;
+				std::vector< uint32_t > used_;
+		};
+		
+		// most tiles and most points in one pass. with everything set every
+		// tile of the hand has to be placed, -1 for both when it does not fit
+		Placement solve( const Hand &hand, const Hand &field, bool everything );
+		
+		Layer current_;
+		Layer next_;
+};
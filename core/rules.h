@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// compile time description of a rule variant, everything that depends on the
+// size of the tile universe (tables, masks, set capacity) is derived from it
+template < size_t Colors, size_t Numbers, size_t Copies, size_t Jokers, size_t Hand >
+struct Ruleset
+{
+	static_assert( Colors >= 3 && Colors <= 8, "a tile id has room for up to 8 colors" );
+	static_assert( Numbers >= 3 && Numbers <= 24, "color and number bits must fit a 32 bit mask" );
+	
+	static constexpr size_t colors = Colors;
+	static constexpr size_t numbers = Numbers;
+	static constexpr size_t copies = Copies;
+	static constexpr size_t jokers = Jokers;
+	static constexpr size_t hand = Hand;
+	
+	// total number of tiles in the pool at the start of a game
+	static constexpr size_t tiles = Colors * Numbers * Copies + Jokers;
+	
+	// a tile id is ( number << colorBits ) | color
+	static constexpr size_t colorBits = Colors <= 4 ? 2 : 3;
+	static constexpr size_t ids = ( Numbers + 1 ) << colorBits;
+	
+	// largest valid set, a run over every number or a group of every color
+	static constexpr size_t setSize = Numbers > Colors ? Numbers : Colors;
+	
+	// one hot masks, colors in the low bits followed by the numbers
+	static constexpr uint32_t colorMask = ( 1u << Colors ) - 1;
+	static constexpr uint32_t numberMask = ( ( 1u << Numbers ) - 1 ) << Colors;
+	
+	static_assert( ids <= 256, "a tile id must fit in a byte" );
+};
+
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::colors;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::numbers;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::copies;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::jokers;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::hand;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::tiles;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::colorBits;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::ids;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr size_t Ruleset< C, N, P, J, H >::setSize;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr uint32_t Ruleset< C, N, P, J, H >::colorMask;
+template < size_t C, size_t N, size_t P, size_t J, size_t H > constexpr uint32_t Ruleset< C, N, P, J, H >::numberMask;
+
+namespace rules
+{
+	// the box game, two jokers and 16 tiles per player
+	using standard = Ruleset< 4, 13, 2, 2, 16 >;
+	
+	// two extra colors, numbers up to 20 and a third copy of every tile and joker
+	using extended = Ruleset< 6, 20, 3, 3, 14 >;
+	
+	// enough tiles for 8 players
+	using large = Ruleset< 8, 20, 4, 4, 14 >;
+}
+
+// the variant the server and client are built for, see RUMMIKUB_RULES in cmake
+#ifndef RUMMIKUB_RULES
+#define RUMMIKUB_RULES standard
+#endif
+
+using Rules = rules::RUMMIKUB_RULES;
@@ -0,0 +1,403 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+#include <string>
+#include <array>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cctype>
+
+#include "rules.h"
+
+// a tile is stored in a single byte, the low Rules::colorBits hold the color
+// (A, B, C, ...) and the bits above it the number. the number is in the high
+// bits so tiles sort by number first, id zero is not a tile. the joker has
+// number zero and id one, it sorts before every numbered tile and is written
+// as J00
+namespace tile
+{
+	constexpr size_t joker = 1;
+	
+	// what a joker left in a hand costs at the end of a game
+	constexpr size_t jokerPoints = 30;
+	
+	template < typename R >
+	constexpr bool numbered( size_t id )
+	{
+		return ( id >> R::colorBits ) >= 1 && ( id >> R::colorBits ) <= R::numbers && ( id & ( ( 1u << R::colorBits ) - 1 ) ) < R::colors;
+	}
+	
+	template < typename R >
+	constexpr bool valid( size_t id )
+	{
+		return id == joker || numbered< R >( id );
+	}
+	
+	// the joker has neither a color nor a number bit
+	template < typename R >
+	constexpr uint32_t mask( size_t id )
+	{
+		return numbered< R >( id ) ?
+			( 1u << ( id & ( ( 1u << R::colorBits ) - 1 ) ) ) | ( 1u << ( ( id >> R::colorBits ) + R::colors - 1 ) ) :
+			0;
+	}
+	
+	template < typename R >
+	constexpr uint8_t value( size_t id )
+	{
+		return numbered< R >( id ) ? id >> R::colorBits : 0;
+	}
+	
+	struct Name
+	{
+		char text[ 4 ];
+	};
+	
+	template < typename R >
+	constexpr Name name( size_t id )
+	{
+		return id == joker ?
+			Name { { 'J', '0', '0', 0 } } :
+			numbered< R >( id ) ?
+			Name { {
+				char( 'A' + ( id & ( ( 1u << R::colorBits ) - 1 ) ) ),
+				char( '0' + ( id >> R::colorBits ) / 10 ),
+				char( '0' + ( id >> R::colorBits ) % 10 ),
+				0
+			} } :
+			Name { { '?', '?', '?', 0 } };
+	}
+	
+	template < size_t... I >
+	struct indices {};
+	
+	template < size_t N, size_t... I >
+	struct make_indices : make_indices< N - 1, N - 1, I... > {};
+	
+	template < size_t... I >
+	struct make_indices< 0, I... >
+	{
+		using type = indices< I... >;
+	};
+	
+	template < typename T, size_t... I >
+	constexpr std::array< T, sizeof...( I ) > table( T ( *f )( size_t ), indices< I... > )
+	{
+		return {{ f( I )... }};
+	}
+	
+	template < typename R >
+	struct Table
+	{
+		static constexpr std::array< uint32_t, R::ids > masks = table( mask< R >, typename make_indices< R::ids >::type() );
+		static constexpr std::array< uint8_t, R::ids > values = table( value< R >, typename make_indices< R::ids >::type() );
+		static constexpr std::array< Name, R::ids > names = table( name< R >, typename make_indices< R::ids >::type() );
+	};
+	
+	template < typename R > constexpr std::array< uint32_t, R::ids > Table< R >::masks;
+	template < typename R > constexpr std::array< uint8_t, R::ids > Table< R >::values;
+	template < typename R > constexpr std::array< Name, R::ids > Table< R >::names;
+}
+
+template < typename R >
+class BasicTile
+{
+	using table = tile::Table< R >;
+	
+	public:
+		
+		using rules = R;
+		
+		BasicTile() :
+			data_( 0 ) {}
+		
+		// value 1 to R::numbers, color starting at 0 for A
+		static BasicTile fromValue( size_t value, size_t color )
+		{
+			BasicTile t;
+			t.data_ = static_cast< uint8_t >( value << R::colorBits | color );
+			return t;
+		}
+		
+		// the tile stored as id, the joker included
+		static BasicTile fromId( uint8_t id )
+		{
+			BasicTile t;
+			t.data_ = id;
+			return t;
+		}
+		
+		static BasicTile joker()
+		{
+			BasicTile t;
+			t.data_ = tile::joker;
+			return t;
+		}
+		
+		operator uint32_t() const
+		{
+			return table::masks[ data_ ];
+		}
+		
+		uint8_t id() const
+		{
+			return data_;
+		}
+		
+		bool valid() const
+		{
+			return tile::valid< R >( data_ );
+		}
+		
+		bool isJoker() const
+		{
+			return data_ == tile::joker;
+		}
+		
+		uint32_t color() const
+		{
+			return table::masks[ data_ ] & R::colorMask;
+		}
+		
+		uint32_t number() const
+		{
+			return table::masks[ data_ ] & R::numberMask;
+		}
+		
+		// the number, zero for the joker
+		size_t value() const
+		{
+			return table::values[ data_ ];
+		}
+		
+		// what the tile costs when it is left in a hand
+		size_t points() const
+		{
+			return isJoker() ? tile::jokerPoints : value();
+		}
+		
+		size_t colorIndex() const
+		{
+			return data_ & ( ( 1u << R::colorBits ) - 1 );
+		}
+		
+		const char* name() const
+		{
+			return table::names[ data_ ].text;
+		}
+		
+		// same color one number lower, not valid below one
+		BasicTile previous() const
+		{
+			return value() > 1 ? fromValue( value() - 1, colorIndex() ) : BasicTile();
+		}
+		
+		// same color one number higher, not valid above R::numbers
+		BasicTile next() const
+		{
+			return value() && value() < R::numbers ? fromValue( value() + 1, colorIndex() ) : BasicTile();
+		}
+		
+		friend bool operator == ( BasicTile a, BasicTile b )
+		{
+			return a.data_ == b.data_;
+		}
+		
+		friend bool operator != ( BasicTile a, BasicTile b )
+		{
+			return a.data_ != b.data_;
+		}
+		
+		friend bool operator < ( BasicTile a, BasicTile b )
+		{
+			return a.data_ < b.data_;
+		}
+		
+		static bool compareNumber( BasicTile a, BasicTile b )
+		{
+			return a.number() == b.number();
+		}
+		
+		static bool compareColor( BasicTile a, BasicTile b )
+		{
+			return a.color() == b.color();
+		}
+		
+	private:
+		uint8_t data_;
+};
+
+// fixed capacity container that keeps its elements inline, used for sets on
+// the field so a field is a single contiguous allocation instead of one per set
+template < typename T, size_t N >
+class SmallVector
+{
+	static_assert( N < 256, "SmallVector stores its size in a byte" );
+	
+	public:
+		
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+		
+		SmallVector() :
+			size_( 0 ) {}
+		
+		iterator begin() { return data_; }
+		iterator end() { return data_ + size_; }
+		const_iterator begin() const { return data_; }
+		const_iterator end() const { return data_ + size_; }
+		
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+		static constexpr size_t capacity() { return N; }
+		
+		T& front() { return data_[ 0 ]; }
+		T& back() { return data_[ size_ - 1 ]; }
+		const T& front() const { return data_[ 0 ]; }
+		const T& back() const { return data_[ size_ - 1 ]; }
+		
+		void push_back( const T &t )
+		{
+			if ( size_ == N )
+			{
+				throw std::length_error( "set holds more than " + std::to_string( N ) + " tiles" );
+			}
+			data_[ size_++ ] = t;
+		}
+		
+		iterator insert( iterator pos, const T &t )
+		{
+			if ( size_ == N )
+			{
+				throw std::length_error( "set holds more than " + std::to_string( N ) + " tiles" );
+			}
+			std::move_backward( pos, end(), end() + 1 );
+			*pos = t;
+			++size_;
+			return pos;
+		}
+		
+		void pop_back()
+		{
+			--size_;
+		}
+		
+		void clear()
+		{
+			size_ = 0;
+		}
+		
+	private:
+		T data_[ N ];
+		uint8_t size_;
+};
+
+template < typename R >
+using BasicSet = SmallVector< BasicTile< R >, R::setSize >;
+
+template < typename R >
+struct BasicCombinations : std::vector< BasicSet< R > >
+{
+	std::vector< BasicTile< R > > tiles() const
+	{
+		std::vector< BasicTile< R > > result;
+		for ( auto &set : *this )
+		{
+			result.insert( result.end(), set.begin(), set.end() );
+		}
+		return result;
+	}
+};
+
+using Strings = std::vector< std::string >;
+using Tile = BasicTile< Rules >;
+using Tiles = std::vector< Tile >;
+using Set = BasicSet< Rules >;
+using Combinations = BasicCombinations< Rules >;
+
+template < typename R >
+std::ostream& operator << ( std::ostream &stream, const BasicTile< R > &t )
+{
+	if ( !t.valid() )
+	{
+		throw std::runtime_error( "unknown tile" );
+	}
+	
+	return stream.write( t.name(), 3 );
+}
+
+template < typename R >
+std::ostream& operator << ( std::ostream &stream, const std::vector< BasicTile< R > > &t )
+{
+	std::copy( std::begin( t ), std::end( t ), std::ostream_iterator< BasicTile< R > >( stream, " " ) );
+	return stream;
+}
+
+template < typename R >
+std::ostream& operator << ( std::ostream &stream, const BasicSet< R > &t )
+{
+	std::copy( std::begin( t ), std::end( t ), std::ostream_iterator< BasicTile< R > >( stream, " " ) );
+	return stream;
+}
+
+template < typename R >
+std::ostream& operator << ( std::ostream &stream, const BasicCombinations< R > &t )
+{
+	std::copy( std::begin( t ), std::end( t ), std::ostream_iterator< BasicSet< R > >( stream, "\n" ) );
+	return stream;
+}
+
+// reads the tiles on a single line, characters that do not form a tile are skipped
+template < typename T >
+void parse( const std::string &line, T &tiles )
+{
+	using tile_type = typename T::value_type;
+	using R = typename tile_type::rules;
+	
+	for ( auto i = line.begin(), end = line.end(); i != end; )
+	{
+		const char c = *i++;
+		if ( c == 'J' && i != end && *i == '0' )
+		{
+			while ( i != end && *i == '0' )
+			{
+				++i;
+			}
+			tiles.push_back( tile_type::joker() );
+			continue;
+		}
+		
+		if ( c < 'A' || c >= char( 'A' + R::colors ) )
+		{
+			continue;
+		}
+		
+		const auto digits = i;
+		size_t t = 0;
+		while ( i != end && isdigit( *i ) )
+		{
+			t = std::min< size_t >( t * 10 + ( *i++ - '0' ), 100 );
+		}
+		
+		if ( i != digits && t > 0 && t <= R::numbers )
+		{
+			tiles.push_back( tile_type::fromValue( t, c - 'A' ) );
+		}
+	}
+}
+
+template < typename T, typename Cmp >
+void sort( T &t, Cmp c )
+{
+	std::sort( std::begin( t ), std::end( t ), c );
+}
+
+template < typename T >
+void sort( T &t )
+{
+	std::sort( std::begin( t ), std::end( t ) );
+}
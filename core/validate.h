@@ -0,0 +1,52 @@
+#pragma once
+
+#include "tile.h"
+#include "kernels.h"
+
+// jokers stand in for any tile, so instead of trying substitutions the
+// numbered tiles are checked on their own and the jokers only have to cover
+// what is missing: the gaps of a run and its length, or the missing colors of
+// a group. this keeps validation a handful of mask operations. it is always
+// inlined so every clone of a RUMMIKUB_KERNEL caller gets its own copy
+template < typename R >
+__attribute__(( always_inline )) inline bool setIsValid( const BasicSet< R > &tiles )
+{
+	auto begin = tiles.begin(), end = tiles.end();
+	const size_t size = end - begin;
+	if ( size < 3 )
+	{
+		return false;
+	}
+
+	uint32_t mask = 0;
+	size_t jokers = 0;
+	
+	while ( begin != end )
+	{
+		jokers += begin->isJoker();
+		mask |= *begin++;
+	}
+	
+	const size_t numbered = size - jokers;
+	if ( numbered == 0 )
+	{
+		return size <= R::setSize;
+	}
+	
+	const auto colorCount = hamming_weight( mask & R::colorMask );
+	const uint32_t numbers = mask & R::numberMask;
+	
+	// a run has a single color and consecutive numbers, the jokers fill the
+	// gaps and may extend it as long as it stays within the numbers
+	if ( colorCount == 1 && hamming_weight( numbers ) == numbered )
+	{
+		const size_t span = highest_bit( numbers ) - lowest_bit( numbers ) + 1;
+		if ( span - numbered <= jokers && size <= R::numbers )
+		{
+			return true;
+		}
+	}
+	
+	// a group has a single number and every tile in a different color
+	return colorCount == numbered && hamming_weight( numbers ) == 1 && size <= R::colors;
+}
@@ -0,0 +1,282 @@
+#include "analyze.h"
+#include "dataset.h"
+#include "oracle.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace
+{
+	struct Seat
+	{
+		size_t moves { 0 };
+		size_t optimal { 0 };
+		size_t placed { 0 };
+		size_t best { 0 };
+		size_t regretTiles { 0 };
+		size_t regretPoints { 0 };
+	};
+	
+	// hand and field of a row, as tile counts
+	struct Position
+	{
+		Hand hand;
+		Hand field;
+	};
+	
+	// the tile counts of hand and field, the oracle only depends on those so
+	// positions that differ in the layout of the field share a result. every
+	// count of the joker and of each number per color takes countBits bits
+	const size_t kinds = Rules::colors * Rules::numbers + 1;
+	const size_t most = Rules::copies > Rules::jokers ? Rules::copies : Rules::jokers;
+	const size_t countBits = most < 4 ? 2 : most < 8 ? 3 : 4;
+	const size_t perWord = 64 / countBits;
+	
+	using Key = array< uint64_t, ( 2 * kinds + perWord - 1 ) / perWord >;
+	
+	struct KeyHash
+	{
+		size_t operator () ( const Key &key ) const
+		{
+			uint64_t h = 0;
+			for ( auto word : key )
+			{
+				h = ( h ^ word ) * 0x9e3779b97f4a7c15ull;
+			}
+			return h ^ h >> 32;
+		}
+	};
+	
+	Key positionKey( const Position &position )
+	{
+		Key key {};
+		size_t i = 0;
+		for ( auto hand : { &position.hand, &position.field } )
+		{
+			for ( size_t id = 0; id < Rules::ids; ++id )
+			{
+				if ( tile::valid< Rules >( id ) )
+				{
+					key[ i / perWord ] |= uint64_t( hand->counts()[ id ] ) << ( i % perWord * countBits );
+					++i;
+				}
+			}
+		}
+		return key;
+	}
+	
+	// more copies of a tile than the rules have do not fit the key
+	void addTile( Hand &hand, uint8_t id )
+	{
+		if ( !tile::valid< Rules >( id ) || hand.count( Tile::fromId( id ) ) == ( tile::joker == id ? Rules::jokers : Rules::copies ) )
+		{
+			throw runtime_error( "dataset holds a tile the rules do not have" );
+		}
+		hand.add( Tile::fromId( id ) );
+	}
+	
+	// tiles and points the move took from the hand
+	void placed( DatasetReader::Blob field, DatasetReader::Blob removed, DatasetReader::Blob added, int &tiles, int &points )
+	{
+		tiles = points = 0;
+		for ( size_t i = 0; i < added.size; ++i )
+		{
+			if ( added.data[ i ] )
+			{
+				++tiles;
+				points += Tile::fromId( added.data[ i ] ).points();
+			}
+		}
+		
+		size_t set = 0, r = 0;
+		for ( size_t i = 0; i < field.size && r < removed.size; ++i )
+		{
+			if ( !field.data[ i ] )
+			{
+				r += removed.data[ r ] == set++;
+			}
+			else if ( removed.data[ r ] == set )
+			{
+				--tiles;
+				points -= Tile::fromId( field.data[ i ] ).points();
+			}
+		}
+	}
+	
+	// solves every position on all cores, one oracle per thread
+	void solve( const vector< Position > &positions, vector< Placement > &results )
+	{
+		results.resize( positions.size() );
+		atomic< size_t > next( 0 );
+		
+		auto work = [&]()
+		{
+			Oracle oracle;
+			for ( size_t i; ( i = next++ ) < positions.size(); )
+			{
+				results[ i ] = oracle.best( positions[ i ].hand, positions[ i ].field );
+			}
+		};
+		
+		vector< thread > threads;
+		for ( size_t i = 1; i < max( 1u, thread::hardware_concurrency() ); ++i )
+		{
+			threads.emplace_back( work );
+		}
+		work();
+		for ( auto &t : threads )
+		{
+			t.join();
+		}
+	}
+}
+
+int analyze( int argc, char *argv[] )
+{
+	if ( argc < 3 )
+	{
+		cerr << "usage: " << argv[ 0 ] << " --analyze <dataset> [<bot> <bot> [...]]\n";
+		return 1;
+	}
+	
+	try
+	{
+		DatasetReader reader( argv[ 2 ] );
+		
+		vector< Seat > seats;
+		// the index of every distinct position of the current game in the
+		// placements of the current chunk, positions hardly ever repeat
+		// across games so neither is kept for longer
+		unordered_map< Key, size_t, KeyHash > solved;
+		vector< Placement > placements;
+		size_t rows = 0, unique = 0, aboveOracle = 0;
+		
+		vector< uint8_t > buffers[ dataset::columns ];
+		vector< Position > pending;
+		vector< Placement > results;
+		
+		const auto start = chrono::steady_clock::now();
+		for ( size_t chunk = 0; chunk < reader.chunks(); ++chunk )
+		{
+			const size_t count = reader.rows( chunk );
+			auto column = [&]( dataset::Column c )
+			{
+				return reader.column( chunk, c, buffers[ c ] );
+			};
+			const auto game = column( dataset::game );
+			const auto player = column( dataset::player );
+			const auto hand = column( dataset::hand );
+			const auto field = column( dataset::field );
+			const auto removed = column( dataset::removed );
+			const auto added = column( dataset::added );
+			
+			// the positions of this chunk that were not seen before
+			vector< size_t > indices( count );
+			pending.clear();
+			placements.clear();
+			solved.clear();
+			for ( size_t row = 0; row < count; ++row )
+			{
+				if ( row && memcmp( game.data + row * 8, game.data + ( row - 1 ) * 8, 8 ) )
+				{
+					solved.clear();
+				}
+				
+				Position position;
+				for ( size_t id = 0; id < Rules::ids; ++id )
+				{
+					for ( size_t n = hand.data[ row * Rules::ids + id ]; n--; )
+					{
+						addTile( position.hand, id );
+					}
+				}
+				const auto tiles = DatasetReader::row( field, count, row );
+				for ( size_t i = 0; i < tiles.size; ++i )
+				{
+					if ( tiles.data[ i ] )
+					{
+						addTile( position.field, tiles.data[ i ] );
+					}
+				}
+				
+				const auto found = solved.insert( make_pair( positionKey( position ), placements.size() + pending.size() ) );
+				if ( found.second )
+				{
+					pending.push_back( position );
+				}
+				indices[ row ] = found.first->second;
+			}
+			
+			solve( pending, results );
+			unique += pending.size();
+			placements.insert( placements.end(), results.begin(), results.end() );
+			
+			for ( size_t row = 0; row < count; ++row )
+			{
+				const auto best = placements[ indices[ row ] ];
+				if ( best.tiles < 0 )
+				{
+					continue;
+				}
+				
+				int tiles, points;
+				placed( DatasetReader::row( field, count, row ), DatasetReader::row( removed, count, row ),
+					DatasetReader::row( added, count, row ), tiles, points );
+				
+				const size_t p = player.data[ row ];
+				if ( seats.size() <= p )
+				{
+					seats.resize( p + 1 );
+				}
+				auto &seat = seats[ p ];
+				++seat.moves;
+				seat.placed += tiles;
+				seat.best += best.tiles;
+				seat.optimal += tiles >= best.tiles;
+				seat.regretTiles += max( best.tiles - tiles, 0 );
+				seat.regretPoints += max( best.points - points, 0 );
+				aboveOracle += tiles > best.tiles;
+			}
+			rows += count;
+		}
+		const double seconds = chrono::duration< double >( chrono::steady_clock::now() - start ).count();
+		
+		cout << "positions: " << rows
+			<< ", unique: " << unique
+			<< ", seconds: " << seconds
+			<< ", positions/sec: " << rows / seconds << '\n';
+		if ( aboveOracle )
+		{
+			cout << "moves above the oracle: " << aboveOracle << '\n';
+		}
+		
+		for ( size_t p = 0; p < seats.size(); ++p )
+		{
+			auto &seat = seats[ p ];
+			const double moves = max< size_t >( seat.moves, 1 );
+			cout << ( int( p ) + 3 < argc ? argv[ p + 3 ] : "player" ) << '(' << p + 1 << ")"
+				<< ": moves " << seat.moves
+				<< ", optimal " << fixed << setprecision( 1 ) << 100 * seat.optimal / moves << '%'
+				<< ", tiles placed " << seat.placed << " of " << seat.best
+				<< ", regret per move " << setprecision( 3 ) << seat.regretTiles / moves << " tiles, "
+				<< seat.regretPoints / moves << " points\n" << defaultfloat;
+		}
+	}
+	catch ( const exception &err )
+	{
+		cerr << err.what() << endl;
+		return 1;
+	}
+	
+	return 0;
+}
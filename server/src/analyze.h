@@ -0,0 +1,7 @@
+#pragma once
+
+// replays the positions of a dataset written by --selfplay against the
+// exact placement oracle and reports how far every player fell short:
+//   r_server --analyze <dataset> [<bot> <bot> [...]]
+// the bot names only label the seats, in the order they were played in
+int analyze( int argc, char *argv[] );
@@ -0,0 +1,364 @@
+#include "checkpoint.h"
+#include "bytes.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct Checkpoint::Slot
+{
+	atomic< uint64_t > sequence;
+	uint32_t bytes;
+	uint32_t reserved;
+	
+	uint8_t* data()
+	{
+		return reinterpret_cast< uint8_t* >( this + 1 );
+	}
+};
+
+namespace
+{
+	const char magic[ 4 ] = { 'R', 'K', 'C', 'P' };
+	const uint32_t version = 2;
+	
+	// seed, game, players and the fields of Turn
+	const size_t turnBytes = 40;
+	
+	using bytes::put;
+	using bytes::take;
+	using bytes::writeAll;
+	
+	volatile sig_atomic_t stopSignal = 0;
+	
+	void requestStop( int signal )
+	{
+		stopSignal = signal;
+		std::signal( signal, SIG_DFL );
+	}
+	
+	vector< uint8_t > header( const results::Shard &tournament )
+	{
+		vector< uint8_t > out( magic, magic + 4 );
+		put< uint32_t >( out, version );
+		put< uint32_t >( out, Rules::ids );
+		put< uint32_t >( out, tournament.players.size() );
+		put< uint64_t >( out, tournament.first );
+		put< uint64_t >( out, tournament.games );
+		for ( auto &name : tournament.players )
+		{
+			put< uint32_t >( out, name.size() );
+			out.insert( out.end(), name.begin(), name.end() );
+		}
+		return out;
+	}
+	
+	size_t recordSize( size_t players )
+	{
+		return 8 + players * 4;
+	}
+	
+	// count tile ids from p, false when they run past end or one is not a tile
+	template < typename T >
+	bool readTiles( const uint8_t *&p, const uint8_t *end, size_t count, T &out )
+	{
+		if ( size_t( end - p ) < count )
+		{
+			return false;
+		}
+		for ( ; count; --count )
+		{
+			const auto t = Tile::fromId( *p++ );
+			if ( !t.valid() )
+			{
+				return false;
+			}
+			out.push_back( t );
+		}
+		return true;
+	}
+}
+
+Checkpoint::Checkpoint( const string &path, const results::Shard &tournament ) :
+	path_( path ),
+	fd_( -1 ),
+	slotSize_( 0 ),
+	mapped_( nullptr ),
+	sequence_( 0 )
+{
+	totals_.first = tournament.first;
+	totals_.players = tournament.players;
+	totals_.scores.resize( tournament.players.size() );
+	
+	fd_ = open( path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644 );
+	if ( fd_ < 0 )
+	{
+		throw runtime_error( "could not open checkpoint: " + path );
+	}
+	
+	// releases what is open so far, ~Checkpoint is not called for a
+	// checkpoint that failed to open
+	auto fail = [this]( const string &why )
+	{
+		if ( mapped_ )
+		{
+			munmap( mapped_, 2 * slotSize_ );
+		}
+		close( fd_ );
+		throw runtime_error( why );
+	};
+	
+	const auto expected = header( tournament );
+	struct stat info;
+	if ( fstat( fd_, &info ) != 0 )
+	{
+		fail( "could not open checkpoint: " + path );
+	}
+	
+	const bool fresh = info.st_size == 0;
+	if ( fresh )
+	{
+		if ( !writeAll( fd_, expected.data(), expected.size() ) )
+		{
+			fail( "could not write checkpoint: " + path );
+		}
+	}
+	else
+	{
+		vector< uint8_t > file( info.st_size );
+		if ( pread( fd_, file.data(), file.size(), 0 ) != info.st_size ||
+			file.size() < expected.size() ||
+			!equal( expected.begin(), expected.end(), file.begin() ) )
+		{
+			fail( "checkpoint of another tournament: " + path );
+		}
+		
+		// a record cut short by a kill is dropped, its game is played again
+		const size_t players = totals_.players.size();
+		const size_t records = ( file.size() - expected.size() ) / recordSize( players );
+		const uint8_t *p = file.data() + expected.size();
+		vector< results::Score > score( players );
+		for ( size_t r = 0; r < records; ++r )
+		{
+			const auto moves = take< uint64_t >( p );
+			for ( auto &s : score )
+			{
+				s.points = take< uint16_t >( p );
+				s.wins = take< uint8_t >( p );
+				s.disqualified = take< uint8_t >( p );
+			}
+			results::add( totals_, moves, score );
+		}
+		if ( ftruncate( fd_, expected.size() + records * recordSize( players ) ) != 0 )
+		{
+			fail( "could not write checkpoint: " + path );
+		}
+	}
+	
+	// the turn, then every tile at most once plus the length of every set
+	slotSize_ = ( sizeof( Slot ) + turnBytes + 2 * ( totals_.players.size() + 2 ) + 2 * Rules::tiles + 63 ) & ~size_t( 63 );
+	buffer_.reserve( slotSize_ );
+	
+	const string game = path + ".game";
+	// a game left by an earlier tournament at the same path is dropped
+	const int fd = open( game.c_str(), O_RDWR | O_CREAT | ( fresh ? O_TRUNC : 0 ), 0644 );
+	if ( fd < 0 || ftruncate( fd, 2 * slotSize_ ) != 0 ||
+		( mapped_ = mmap( nullptr, 2 * slotSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) ) == MAP_FAILED )
+	{
+		mapped_ = nullptr;
+		if ( fd >= 0 )
+		{
+			close( fd );
+		}
+		fail( "could not map checkpoint: " + game );
+	}
+	close( fd );
+	
+	sequence_ = max( slot( 0 )->sequence.load(), slot( 1 )->sequence.load() );
+	
+	signal( SIGINT, requestStop );
+	signal( SIGTERM, requestStop );
+}
+
+Checkpoint::~Checkpoint()
+{
+	signal( SIGINT, SIG_DFL );
+	signal( SIGTERM, SIG_DFL );
+	
+	if ( mapped_ )
+	{
+		munmap( mapped_, 2 * slotSize_ );
+	}
+	if ( fd_ >= 0 )
+	{
+		close( fd_ );
+	}
+}
+
+bool Checkpoint::stopping()
+{
+	return stopSignal != 0;
+}
+
+Checkpoint::Slot* Checkpoint::slot( size_t i ) const
+{
+	return reinterpret_cast< Slot* >( static_cast< uint8_t* >( mapped_ ) + i * slotSize_ );
+}
+
+bool Checkpoint::resume( Turn &turn, Tiles &pool, vector< Tiles > &hands, Combinations &field )
+{
+	Slot *current = slot( 0 )->sequence > slot( 1 )->sequence ? slot( 0 ) : slot( 1 );
+	if ( !current->sequence || current->bytes < turnBytes || current->bytes > slotSize_ - sizeof( Slot ) )
+	{
+		return false;
+	}
+	
+	// nothing is applied unless the slot is this game of this tournament
+	// and every tile in it is known
+	const uint8_t *p = current->data(), *end = p + current->bytes;
+	Turn saved;
+	saved.seed = take< uint64_t >( p );
+	const auto game = take< uint64_t >( p );
+	const auto players = take< uint32_t >( p );
+	saved.moves = take< uint32_t >( p );
+	saved.round = take< uint32_t >( p );
+	saved.seat = take< uint32_t >( p );
+	saved.fieldSize = take< uint32_t >( p );
+	saved.resumed = take< uint32_t >( p );
+	if ( saved.seed != next() || game != totals_.games || players != totals_.players.size() || saved.seat >= players )
+	{
+		return false;
+	}
+	
+	Tiles savedPool;
+	vector< Tiles > savedHands( players );
+	for ( size_t i = 0; i <= players; ++i )
+	{
+		if ( end - p < 2 )
+		{
+			return false;
+		}
+		const size_t count = take< uint16_t >( p );
+		if ( !readTiles( p, end, count, i ? savedHands[ i - 1 ] : savedPool ) )
+		{
+			return false;
+		}
+	}
+	
+	Combinations savedField;
+	if ( end - p < 2 )
+	{
+		return false;
+	}
+	for ( size_t sets = take< uint16_t >( p ); sets; --sets )
+	{
+		if ( p == end || *p > Rules::setSize )
+		{
+			return false;
+		}
+		const size_t count = *p++;
+		Set set;
+		if ( !readTiles( p, end, count, set ) )
+		{
+			return false;
+		}
+		savedField.push_back( set );
+	}
+	
+	pool.swap( savedPool );
+	hands.swap( savedHands );
+	field.swap( savedField );
+	turn = saved;
+	++turn.resumed;
+	
+	// the attempt counts even when this run dies at the same move
+	begin( turn );
+	add( pool );
+	for ( auto &hand : hands )
+	{
+		add( hand );
+	}
+	add( field );
+	commit();
+	
+	return true;
+}
+
+void Checkpoint::begin( const Turn &turn )
+{
+	buffer_.clear();
+	put( buffer_, turn.seed );
+	put< uint64_t >( buffer_, totals_.games );
+	put< uint32_t >( buffer_, totals_.players.size() );
+	put( buffer_, turn.moves );
+	put( buffer_, turn.round );
+	put( buffer_, turn.seat );
+	put( buffer_, turn.fieldSize );
+	put( buffer_, turn.resumed );
+}
+
+void Checkpoint::add( const Tiles &tiles )
+{
+	put< uint16_t >( buffer_, tiles.size() );
+	for ( auto t : tiles )
+	{
+		buffer_.push_back( t.id() );
+	}
+}
+
+void Checkpoint::add( const Combinations &field )
+{
+	put< uint16_t >( buffer_, field.size() );
+	for ( auto &set : field )
+	{
+		buffer_.push_back( set.size() );
+		for ( auto t : set )
+		{
+			buffer_.push_back( t.id() );
+		}
+	}
+}
+
+void Checkpoint::commit()
+{
+	if ( buffer_.size() > slotSize_ - sizeof( Slot ) )
+	{
+		throw runtime_error( "game does not fit the checkpoint" );
+	}
+	
+	// the older slot is overwritten, the current one stays valid until the
+	// new one is complete
+	Slot *target = slot( 0 )->sequence < slot( 1 )->sequence ? slot( 0 ) : slot( 1 );
+	target->sequence.store( 0, memory_order_relaxed );
+	atomic_signal_fence( memory_order_seq_cst );
+	target->bytes = buffer_.size();
+	memcpy( target->data(), buffer_.data(), buffer_.size() );
+	atomic_signal_fence( memory_order_seq_cst );
+	target->sequence.store( ++sequence_, memory_order_relaxed );
+}
+
+void Checkpoint::finish( uint64_t moves, const vector< results::Score > &score )
+{
+	buffer_.clear();
+	put< uint64_t >( buffer_, moves );
+	for ( auto &s : score )
+	{
+		put< uint16_t >( buffer_, s.points );
+		put< uint8_t >( buffer_, s.wins );
+		put< uint8_t >( buffer_, s.disqualified );
+	}
+	if ( !writeAll( fd_, buffer_.data(), buffer_.size() ) )
+	{
+		throw runtime_error( "could not write checkpoint: " + path_ );
+	}
+	
+	results::add( totals_, moves, score );
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tile.h"
+#include "results.h"
+
+// progress of a tournament, so a run that was killed or taken down by a bot
+// resumes where it stopped without replaying the games it finished. games
+// are played in seed order, so the finished games are also the cursor of the
+// deal generator, see init_tiles. all integers are in host byte order.
+//
+//   <path>       "RKCP" u32 version, u32 tile ids, u32 players, u64 first
+//                seed, u64 games, per player { u32 length, name }, then a
+//                record appended as every game ends: u64 moves, per player
+//                { u16 points, u8 won, u8 disqualified }
+//   <path>.game  the game in progress before its latest move, in one of two
+//                slots of a shared mapping that are written in turn, each
+//                { u64 sequence, u32 bytes, u32, bytes }. the slot with the
+//                highest sequence is current, a slot is cleared before it is
+//                written so a torn write is never picked. both slots are
+//                cleared when <path> is started anew. the bytes are u64
+//                seed, u64 game, u32 players, u32 moves, round, seat, field
+//                size and resumed, then the pool and every hand as u16 count
+//                and tile ids and the field as u16 sets, each a u8 count and
+//                tile ids
+//
+// saving a turn is a copy into the mapping and the kernel writes it back, so
+// the game in progress survives the process but not the machine.
+//
+// while a checkpoint is open SIGINT and SIGTERM ask the run to stop: the move
+// in progress is played out, the next one is saved without counting as an
+// attempt at it and Stopped is thrown. a second signal ends the process at
+// once, which counts like a crash
+class Checkpoint
+{
+	public:
+		
+		struct Stopped {};
+		
+		// where a game stands before a move
+		struct Turn
+		{
+			uint64_t seed { 0 };
+			uint32_t moves { 0 };                   // moves made in the game
+			uint32_t round { 1 };
+			uint32_t seat { 0 };
+			uint32_t fieldSize { uint32_t( -1 ) };  // sets when the round started
+			uint32_t resumed { 0 };                 // runs that resumed at this turn
+		};
+		
+		// opens the checkpoint of tournament at path or starts a new one,
+		// throws when it belongs to another tournament
+		Checkpoint( const std::string &path, const results::Shard &tournament );
+		~Checkpoint();
+		
+		// whether a stop was asked for
+		static bool stopping();
+		
+		Checkpoint( const Checkpoint& ) = delete;
+		Checkpoint& operator = ( const Checkpoint& ) = delete;
+		
+		// the finished games, games counts them
+		const results::Shard& totals() const
+		{
+			return totals_;
+		}
+		
+		uint64_t next() const
+		{
+			return totals_.first + totals_.games;
+		}
+		
+		// the state of game next() as last saved and one more resumed, false
+		// when it was not started or the saved game does not belong to it
+		bool resume( Turn &turn, Tiles &pool, std::vector< Tiles > &hands, Combinations &field );
+		
+		// saves the game before a move: begin, then the pool and every hand in
+		// seat order, then the field
+		void begin( const Turn &turn );
+		void add( const Tiles &tiles );
+		void add( const Combinations &field );
+		void commit();
+		
+		// records game next() as finished, score holds 0 or 1 wins
+		void finish( uint64_t moves, const std::vector< results::Score > &score );
+		
+	private:
+		
+		struct Slot;
+		
+		Slot* slot( size_t i ) const;
+		
+		std::string path_;
+		results::Shard totals_;
+		int fd_;
+		size_t slotSize_;
+		void *mapped_;
+		uint64_t sequence_;
+		std::vector< uint8_t > buffer_;
+};
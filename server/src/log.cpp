@@ -0,0 +1,203 @@
+#include "log.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	// writes to the stdio stream, cout is redirected to the bots while they
+	// are called
+	class Writer
+	{
+		public:
+			
+			Writer() :
+				stop_( false ),
+				busy_( false ),
+				thread_( [this]() { run(); } ) {}
+			
+			~Writer()
+			{
+				{
+					lock_guard< mutex > lock( mutex_ );
+					stop_ = true;
+				}
+				ready_.notify_one();
+				thread_.join();
+			}
+			
+			// queues text and leaves an empty buffer with some capacity in it
+			void push( string &text )
+			{
+				{
+					lock_guard< mutex > lock( mutex_ );
+					queue_.push_back( move( text ) );
+					if ( spare_.empty() )
+					{
+						text = string();
+					}
+					else
+					{
+						text = move( spare_.back() );
+						spare_.pop_back();
+					}
+				}
+				ready_.notify_one();
+			}
+			
+			void drain()
+			{
+				unique_lock< mutex > lock( mutex_ );
+				idle_.wait( lock, [this]() { return queue_.empty() && !busy_; } );
+			}
+			
+		private:
+			
+			void run()
+			{
+				unique_lock< mutex > lock( mutex_ );
+				for ( ;; )
+				{
+					ready_.wait( lock, [this]() { return stop_ || !queue_.empty(); } );
+					if ( queue_.empty() )
+					{
+						return;
+					}
+					
+					string text = move( queue_.front() );
+					queue_.pop_front();
+					const bool last = queue_.empty();
+					busy_ = true;
+					lock.unlock();
+					
+					fwrite( text.data(), 1, text.size(), stdout );
+					if ( last )
+					{
+						fflush( stdout );
+					}
+					
+					lock.lock();
+					busy_ = false;
+					if ( spare_.size() < 16 )
+					{
+						text.clear();
+						spare_.push_back( move( text ) );
+					}
+					if ( queue_.empty() )
+					{
+						idle_.notify_all();
+					}
+				}
+			}
+			
+			mutex mutex_;
+			condition_variable ready_, idle_;
+			deque< string > queue_;
+			vector< string > spare_;
+			bool stop_, busy_;
+			thread thread_;
+	};
+	
+	Writer& writer()
+	{
+		static Writer w;
+		return w;
+	}
+	
+	logging::Level fromEnvironment()
+	{
+		const char *name = getenv( "RUMMIKUB_LOG" );
+		if ( !name )
+		{
+			return logging::Level::io;
+		}
+		
+		const string level = name;
+		if ( level == "silent" )
+		{
+			return logging::Level::silent;
+		}
+		if ( level == "results" )
+		{
+			return logging::Level::results;
+		}
+		if ( level == "moves" )
+		{
+			return logging::Level::moves;
+		}
+		if ( level != "io" )
+		{
+			cerr << "unknown RUMMIKUB_LOG level " << level << ", using io\n";
+		}
+		return logging::Level::io;
+	}
+	
+	logging::Level& current()
+	{
+		static logging::Level level = fromEnvironment();
+		return level;
+	}
+}
+
+logging::Level logging::level()
+{
+	return current();
+}
+
+void logging::setLevel( Level level )
+{
+	current() = level;
+}
+
+void logging::drain()
+{
+	writer().drain();
+}
+
+GameLog::GameLog() :
+	level_( logging::level() ),
+	out_( &buffer_ ),
+	null_( nullptr )
+{
+	if ( level_ != logging::Level::silent )
+	{
+		// starts the writer before any game output, so it outlives it
+		writer();
+	}
+}
+
+GameLog::~GameLog()
+{
+	flush();
+}
+
+void GameLog::flush()
+{
+	if ( !buffer_.text.empty() )
+	{
+		writer().push( buffer_.text );
+	}
+}
+
+GameLog::Buffer::int_type GameLog::Buffer::overflow( int_type c )
+{
+	if ( !traits_type::eq_int_type( c, traits_type::eof() ) )
+	{
+		text.push_back( traits_type::to_char_type( c ) );
+	}
+	return traits_type::not_eof( c );
+}
+
+streamsize GameLog::Buffer::xsputn( const char *s, streamsize n )
+{
+	text.append( s, n );
+	return n;
+}
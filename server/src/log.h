@@ -0,0 +1,79 @@
+#pragma once
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// transcript of the games the server plays. every game writes into its own
+// buffer and hands it over after each move, a background thread writes the
+// buffers to stdout so the game loop never waits on a terminal or a file.
+// RUMMIKUB_LOG sets how much is written:
+//   silent    nothing
+//   results   the score of every game and why it ended
+//   moves     also every round, player and the move played
+//   io        also the input every player got, the default
+namespace logging
+{
+	enum class Level
+	{
+		silent,
+		results,
+		moves,
+		io
+	};
+	
+	// RUMMIKUB_LOG until setLevel is called
+	Level level();
+	void setLevel( Level level );
+	
+	// blocks until everything handed over so far is written
+	void drain();
+}
+
+class GameLog
+{
+	public:
+		
+		GameLog();
+		
+		// hands over what is left
+		~GameLog();
+		
+		GameLog( const GameLog& ) = delete;
+		GameLog& operator = ( const GameLog& ) = delete;
+		
+		bool enabled( logging::Level level ) const
+		{
+			return level <= level_;
+		}
+		
+		// the buffer of the game, or a stream that drops everything when
+		// level is not enabled. check enabled first where formatting costs
+		std::ostream& operator () ( logging::Level level )
+		{
+			return enabled( level ) ? out_ : null_;
+		}
+		
+		// passes the buffer to the writer thread, it does not wait for the
+		// write
+		void flush();
+		
+	private:
+		
+		class Buffer : public std::streambuf
+		{
+			public:
+				
+				std::string text;
+				
+			protected:
+				
+				int_type overflow( int_type c ) override;
+				std::streamsize xsputn( const char *s, std::streamsize n ) override;
+		};
+		
+		logging::Level level_;
+		Buffer buffer_;
+		std::ostream out_;
+		std::ostream null_;
+};
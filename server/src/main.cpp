@@ -5,7 +5,6 @@
 #include <memory>
 #include <fstream>
 #include <iterator>
-#include <iomanip>
 #include <sstream>
 #include <chrono>
 #include <algorithm>
@@ -16,170 +15,21 @@
 #include <fcntl.h>
 #include <dlfcn.h>
 
-using namespace std;
-
-namespace color
-{
-	enum type
-	{
-		red = 1 << 0,
-		yellow = 1 << 1,
-		blue = 1 << 2,
-		black = 1 << 3,
-		mask = 0xF
-	};
-}
-
-static const vector< color::type > colors = {
-	color::red,
-	color::yellow,
-	color::blue,
-	color::black
-};
-
-namespace number
-{
-	enum type
-	{
-		one = 1 << 4,
-		two = 1 << 5,
-		three = 1 << 6,
-		four = 1 << 7,
-		five = 1 << 8,
-		six = 1 << 9,
-		seven = 1 << 10,
-		eight = 1 << 11,
-		nine = 1 << 12,
-		ten = 1 << 13,
-		eleven = 1 << 14,
-		twelve = 1 << 15,
-		thirteen = 1 << 16,
-		mask = 0x1FFF0
-	};
-}
-
-size_t value( number::type t )
-{
-	switch ( t )
-	{
-		case number::one:
-			return 1;
-		case number::two:
-			return 2;
-		case number::three:
-			return 3;
-		case number::four:
-			return 4;
-		case number::five:
-			return 5;
-		case number::six:
-			return 6;
-		case number::seven:
-			return 7;
-		case number::eight:
-			return 8;
-		case number::nine:
-			return 9;
-		case number::ten:
-			return 10;
-		case number::eleven:
-			return 11;
-		case number::twelve:
-			return 12;
-		case number::thirteen:
-			return 13;
-		default:
-			return 0;
-	}
-}
-
-static const vector< number::type > numbers = {
-	number::one,
-	number::two,
-	number::three,
-	number::four,
-	number::five,
-	number::six,
-	number::seven,
-	number::eight,
-	number::nine,
-	number::ten,
-	number::eleven,
-	number::twelve,
-	number::thirteen
-};
-
-
-
-class Tile
-{
-	public:
-	
-	Tile( number::type n, color::type c ) :
-			data_( n | c ) {}
-
-		Tile() :
-			data_( 0 ) {}
-	
-	operator uint32_t() const
-	{
-		return data_;
-	}
-		
-		bool valid() const
-		{
-			return ( data_ & color::mask ) && ( data_ & number::mask );
-		}
-	
-	color::type color() const
-	{
-		return static_cast< color::type >( data_ & color::mask );
-	}
-	
-	number::type number() const
-	{
-		return static_cast< number::type >( data_ & number::mask );
-	}
-	
-	static bool compareNumber( Tile a, Tile b )
-	{
-		return a.number() == b.number();
-	}
-	
-	static bool compareColor( Tile a, Tile b )
-	{
-		return a.color() == b.color();
-	}
-	
-	private:
-		uint32_t data_;
-};
-
-
-using Strings = vector< string >;
-using Tiles = vector< Tile >;
+#include "tile.h"
+#include "validate.h"
+#include "game.h"
+#include "profile.h"
+#include "feed.h"
+#include "results.h"
+#include "log.h"
+#include "checkpoint.h"
 
-Tiles init_tiles()
-{
-	Tiles result;
-	
-	for ( int i = 0; i < 2; ++i )
-	{
-		for ( auto &num : numbers )
-		{
-			for ( auto &col : colors )
-			{
-				result.push_back( { num, col } );
-			}
-		}
-	}
-	
-	auto seed = chrono::system_clock::now().time_since_epoch().count();
+#ifdef RUMMIKUB_NATIVE_BOTS
+#include "selfplay.h"
+#include "analyze.h"
+#endif
 
-	shuffle( begin( result ), end( result ), default_random_engine( /*seed*/0 ) );
-	
-	return result;
-}
+using namespace std;
 
 struct Player
 {
@@ -194,7 +44,20 @@ struct Player
 	}
 };
 
-using Combinations = vector< Tiles >;
+// scratch buffers that live as long as a game, they keep their capacity between
+// moves so parsing, diffing and validating a move stops allocating once they
+// have grown to the size of the field
+struct Arena
+{
+	Combinations check {};
+	Tiles after {};
+	Tiles before {};
+	Tiles difference {};
+	
+	// the field before the move, only kept while a spectator feed is open
+	Combinations previous {};
+	feed::Frame frame {};
+};
 
 using Players = vector< Player >;
 
@@ -224,104 +87,85 @@ T trim( T t )
 	return trim_right( trim_left( t ) );
 }
 
-ostream& operator << ( ostream &stream, const Tile &t )
+// a parse error that points at the offending byte of the bot's output
+runtime_error parseError( const string &text, const char *at, const string &what )
 {
-	switch ( t.color() )
-	{
-		case color::red:
-			stream << 'A';
-			break;
-		case color::yellow:
-			stream << 'B';
-			break;
-		case color::blue:
-			stream << 'C';
-			break;
-		case color::black:
-			stream << 'D';
-			break;
-		default:
-			throw runtime_error( "unknown color" );
-	}
-	
-	stream << setw( 2 ) << setfill( '0' ) << value( t.number() );
-	
-	return stream;
-}
-
-istream& operator >> ( istream &str, Tile &tile )
-{
-	char c = 0;
-	int t = 0;
-	str >> c;
-	switch ( c )
-	{
-		case 'A': case 'B': case 'C': case 'D':
-			break;
-		default:
-			return str;
-	}
-	str >> t;
-	if ( t > 0 && t < 14 )
+	size_t line = 1 + count( text.data(), at, '\n' );
+	const char *lineStart = at;
+	while ( lineStart != text.data() && lineStart[ -1 ] != '\n' )
 	{
-		tile = Tile{
-			static_cast< number::type >( 1 << ( t + 3 ) ),
-			static_cast< color::type >( 1 << ( c - 'A' ) )
-		};
+		--lineStart;
 	}
-	return str;
+	stringstream s;
+	s << "bad output at line " << line << ", column " << ( at - lineStart + 1 ) << ": " << what;
+	return runtime_error( s.str() );
 }
 
-istream& operator >> ( istream &str, Tiles &t )
+// parses one set per line in a single pass over the raw bytes. tiles are
+// separated by blanks, anything else is rejected as soon as it is seen, as is
+// a set longer than any valid set or more tiles than the game has. the sets
+// are written into the existing buffer so its capacity is reused
+void parse( const string &text, Combinations &combinations )
 {
-	while ( str )
+	combinations.clear();
+	combinations.emplace_back();
+	
+	size_t total = 0;
+	for ( const char *i = text.data(), *end = i + text.size(); i != end; )
 	{
-		Tile tile;
-		str >> tile;
-		if ( tile.valid() )
+		const char *token = i;
+		const char c = *i++;
+		
+		if ( c == '\n' )
 		{
-			t.push_back( move( tile ) );
+			if ( !combinations.back().empty() )
+			{
+				combinations.emplace_back();
+			}
+			continue;
 		}
-	}
-	return str;
-}
-
-istream& operator >> ( istream &str, Combinations &combinations )
-{
-	for ( string line; getline( str, line ); )
-	{
-		Tiles tmp;
-		istringstream( line ) >> tmp;
-		if ( !tmp.empty() )
+		
+		if ( c == ' ' || c == '\t' || c == '\r' )
+		{
+			continue;
+		}
+		
+		const bool joker = c == 'J';
+		if ( !joker && ( c < 'A' || c >= char( 'A' + Rules::colors ) ) )
 		{
-			combinations.push_back( move( tmp ) );
+			throw parseError( text, token, "unexpected character" );
 		}
+		
+		size_t t = 0, digits = 0;
+		for ( ; i != end && isdigit( *i ) && digits < 3; ++i, ++digits )
+		{
+			t = t * 10 + ( *i - '0' );
+		}
+		
+		// J00 is the joker, every other tile is a color and a number
+		if ( digits == 0 || ( i != end && !isspace( *i ) ) ||
+			( joker ? t != 0 : t == 0 || t > Rules::numbers ) )
+		{
+			throw parseError( text, token, "no such tile" );
+		}
+		
+		if ( combinations.back().size() == Rules::setSize )
+		{
+			throw parseError( text, token, "set has more than " + std::to_string( Rules::setSize ) + " tiles" );
+		}
+		
+		if ( ++total > Rules::tiles )
+		{
+			throw parseError( text, token, "more than " + std::to_string( Rules::tiles ) + " tiles" );
+		}
+		
+		combinations.back().push_back( joker ? Tile::joker() : Tile::fromValue( t, c - 'A' ) );
+	}
+	
+	if ( combinations.back().empty() )
+	{
+		combinations.pop_back();
 	}
-	return str;
-}
-
-ostream& operator << ( ostream &str, const Tiles &t )
-{
-	copy( begin( t ), end( t ), ostream_iterator< Tile >( str, " " ) );
-	return str;
-}
-
-ostream& operator << ( ostream &str, const Combinations &t )
-{
-	copy( begin( t ), end( t ), ostream_iterator< Combinations::value_type >( str, "\n" ) );
-	return str;
-}
-
-template < typename T, typename Cmp >
-void sort( T &t, Cmp c )
-{
-	sort( begin( t ), end( t ), c );
-}
-
-template < typename T >
-void sort( T &t )
-{
-	sort( begin( t ), end( t ) );
 }
 
 template < typename T >
@@ -332,6 +176,61 @@ string to_string( const T &t )
 	return s.str();
 }
 
+// collects a bot's output up to a fixed size, everything written after that
+// is dropped so a runaway bot cannot make the server buffer megabytes
+class OutputBuffer : public streambuf
+{
+	public:
+		
+		// a valid answer spells every tile and a separator in a few bytes,
+		// this leaves room for generous whitespace
+		static const size_t limit = Rules::tiles * 64;
+		
+		OutputBuffer()
+		{
+			buffer_.reserve( limit );
+		}
+		
+		bool overflowed() const
+		{
+			return overflowed_;
+		}
+		
+		const string& str() const
+		{
+			return buffer_;
+		}
+		
+	protected:
+		
+		int_type overflow( int_type c ) override
+		{
+			if ( traits_type::eq_int_type( c, traits_type::eof() ) )
+			{
+				return traits_type::not_eof( c );
+			}
+			const char ch = traits_type::to_char_type( c );
+			return xsputn( &ch, 1 ) == 1 ? c : traits_type::eof();
+		}
+		
+		streamsize xsputn( const char *s, streamsize n ) override
+		{
+			const auto room = static_cast< streamsize >( limit - buffer_.size() );
+			if ( n > room )
+			{
+				overflowed_ = true;
+				n = room;
+			}
+			buffer_.append( s, n );
+			return n;
+		}
+		
+	private:
+		
+		string buffer_;
+		bool overflowed_ { false };
+};
+
 class Dll
 {
 	public:
@@ -349,7 +248,8 @@ class Dll
 			{
 				throw runtime_error( "could not start" );
 			}
-			stringbuf playerInput( input ), playerOutput;
+			stringbuf playerInput( input );
+			OutputBuffer playerOutput;
 			volatile bool done = false;
 			
 			using rbuf = decay< decltype( *cin.rdbuf() ) >::type;
@@ -361,6 +261,7 @@ class Dll
 
 			auto run = [&]()
 			{
+				profile::Scope phase( profile::Phase::call );
 				m( 0, nullptr );
 				done = true;
 			};
@@ -382,6 +283,11 @@ class Dll
 			
 			thread_.join();
 			
+			if ( playerOutput.overflowed() )
+			{
+				throw runtime_error( "output exceeds " + std::to_string( OutputBuffer::limit ) + " bytes" );
+			}
+			
 			return playerOutput.str();
 		}
 		
@@ -398,102 +304,33 @@ string callProcess( const string &input, const string &exe )
 	return dll.call( input, 10000 );
 }
 
-Tiles diff( Tiles a, Tiles b )
+void diff( Tiles &a, Tiles &b, Tiles &result )
 {
 	sort( begin( a ), end( a ) );
 	sort( begin( b ), end( b ) );
-	Tiles result( a.size() + b.size() );
-	
-	auto it = set_difference( begin( a ), end( a ), begin( b ), end( b ), begin( result ) );
 	
-	result.resize( it - begin( result ) );
-		
-	return result;
-}
-
-Tiles diff( const Combinations &a, const Combinations &b )
-{
-	Tiles aa, bb;
-	for ( auto &i : a )
-	{
-		aa.insert( end( aa ), begin( i ), end( i ) );
-	}
-	for ( auto &i : b )
-	{
-		bb.insert( end( bb ), begin( i ), end( i ) );
-	}
-	return diff( aa, bb );
+	result.clear();
+	set_difference( begin( a ), end( a ), begin( b ), end( b ), back_inserter( result ) );
 }
 
-inline uint32_t hamming_weight( uint32_t n )
+void flatten( const Combinations &combinations, Tiles &result )
 {
-	n = n - ((n>>1) & 0x55555555);
-	n = (n & 0x33333333) + ((n>>2) & 0x33333333);
-	return (((n + (n>>4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-}
-
-inline bool sequential( uint32_t v, uint32_t c )
-{
-	if ( !v || hamming_weight( v ) != c )
-	{
-		return false;
-	}
-	
-	// move till first set bit
-	while ( !(v & 1) )
-	{
-		v >>= 1;
-	}
-	
-	// count set bits
-	while ( v & 1 )
+	result.clear();
+	for ( auto &i : combinations )
 	{
-		v >>= 1;
-		--c;
+		result.insert( end( result ), begin( i ), end( i ) );
 	}
-	
-	// all bits should have been tested, so v == 0
-	return ( c == 0 ) && ( v == 0 );
 }
 
-bool setIsValid( const Tiles &tiles )
+const Tiles& diff( const Combinations &a, const Combinations &b, Arena &arena )
 {
-	auto begin = tiles.begin(), end = tiles.end();
-	const auto size = end - begin;
-	if ( size < 3 )
-	{
-		return false;
-	}
-
-	uint32_t mask = 0;
-	
-	while ( begin != end )
-	{
-		mask |= *begin++;
-	}
-	
-	switch ( mask & color::mask )
-	{
-		case color::red:
-		case color::yellow:
-		case color::blue:
-		case color::black:
-			return sequential( mask & number::mask, size );
-			
-		case color::red | color::yellow | color::blue: // no black
-		case color::red | color::yellow | color::black: // no blue
-		case color::red | color::black | color::blue: // no yellow
-		case color::yellow | color::black | color::blue: // no red
-			return size == 3 && hamming_weight( mask & number::mask ) == 1;
-			
-		case color::mask:
-			return size == 4 && hamming_weight( mask & number::mask ) == 1;
-			
-		default:
-			return false;
-	}
+	flatten( a, arena.after );
+	flatten( b, arena.before );
+	diff( arena.after, arena.before, arena.difference );
+	return arena.difference;
 }
 
+RUMMIKUB_KERNEL
 void checkCombinations( const Combinations &combinations )
 {
 	for ( auto &c : combinations )
@@ -526,24 +363,46 @@ void generatePlayerInput( Player &player, const Combinations &combinations, S &&
 		<< combinations;
 }
 
-void run_move( Player &player, Tiles &pool, Combinations &combinations )
+void run_move( Player &player, Tiles &pool, Combinations &combinations, Arena &arena, GameLog &log )
 {
-	stringstream input;
-	generatePlayerInput( player, combinations, input );
+	string input;
+	{
+		profile::Scope phase( profile::Phase::format );
+		stringstream stream;
+		generatePlayerInput( player, combinations, stream );
+		input = stream.str();
+		
+		if ( log.enabled( logging::Level::moves ) )
+		{
+			log( logging::Level::moves ) << "player: " << player.name() << "\n";
+		}
+		if ( log.enabled( logging::Level::io ) )
+		{
+			log( logging::Level::io ) << ">>>\n" << input << "\n<<<\n";
+		}
+	}
 	
-	const string result = callProcess( input.str(), player.executable );
+	string result;
+	{
+		profile::Scope phase( profile::Phase::call );
+		result = callProcess( input, player.executable );
+	}
 	
-	cout << result;
+	log( logging::Level::moves ) << result;
 
-	Combinations check;
-	istringstream( result ) >> check;
+	Combinations &check = arena.check;
+	{
+		profile::Scope phase( profile::Phase::parse );
+		parse( result, check );
+	}
 		
 	if ( tileCount( check ) < tileCount( combinations ) )
 	{
 		throw runtime_error( "tiles removed from field" );
 	}
 	
-	auto difference = diff( check, combinations );
+	profile::Scope diffing( profile::Phase::diff );
+	auto &difference = diff( check, combinations, arena );
 	
 	// check for duplicates
 	
@@ -557,6 +416,7 @@ void run_move( Player &player, Tiles &pool, Combinations &combinations )
 	}
 	else
 	{
+		profile::Scope phase( profile::Phase::validate );
 		for ( auto i : difference )
 		{
 			auto found = find( player.inhand.begin(), player.inhand.end(), i );
@@ -570,7 +430,7 @@ void run_move( Player &player, Tiles &pool, Combinations &combinations )
 		
 		checkCombinations( check );
 		
-		combinations = check;
+		combinations.swap( check );
 	}
 }
 
@@ -579,35 +439,44 @@ size_t points( const Tiles &tiles )
 	size_t total = 0;
 	for ( auto &i : tiles )
 	{
-		total += value( i.number() );
+		total += i.points();
 	}
 	return total;
 }
 
-void endGame( Tiles &pool, Combinations &field, Players &players )
+void endGame( Tiles &pool, Combinations &field, Players &players, GameLog &log )
 {
-	sort( players,
-		[]( const Player &a, const Player &b )
-		{
-			if ( a.disqualified.empty() == b.disqualified.empty() )
-			{
-				return points( a.inhand ) < points( b.inhand );
-			}
-			
-			return a.disqualified.empty();
-		}
-	);
+	// players come in seat order, --selfplay ranks the same way
+	vector< uint64_t > left;
+	vector< bool > disqualified;
+	for ( auto &p : players )
+	{
+		left.push_back( points( p.inhand ) );
+		disqualified.push_back( !p.disqualified.empty() );
+	}
+	Players ranked;
+	for ( auto seat : results::rank( left, disqualified ) )
+	{
+		ranked.push_back( move( players[ seat ] ) );
+	}
+	players = move( ranked );
+	
+	if ( !log.enabled( logging::Level::results ) )
+	{
+		return;
+	}
 	
 	size_t position = 0;
-	cout << "game is finished, score:\n";
+	auto &out = log( logging::Level::results );
+	out << "game is finished, score:\n";
 	for ( auto &p : players )
 	{
-		cout << "nr " << ++position << ": " << p.name();
+		out << "nr " << ++position << ": " << p.name();
 		if ( !p.disqualified.empty() )
 		{
-			cout << "(" << p.disqualified << ")";
+			out << "(" << p.disqualified << ")";
 		}
-		cout << ", " << to_string( points( p.inhand ) ) << " [ " << p.inhand << " ]" << '\n';
+		out << ", " << to_string( points( p.inhand ) ) << " [ " << p.inhand << " ]" << '\n';
 	}
 }
 
@@ -615,6 +484,7 @@ template < typename T >
 Players getPlayers( T &&executables, Tiles &pool )
 {
 	Players players;
+	const auto hands = deal( pool, executables.size() );
 	
 	int id = 0;
 	for ( auto &exe : executables )
@@ -622,81 +492,498 @@ Players getPlayers( T &&executables, Tiles &pool )
 		Player p;
 		p.id = ++id;
 		p.executable = exe;
-		auto start = pool.begin();
-		auto end = start + min< size_t >( 16, pool.size() );
-		p.inhand.assign( start, end );
-		pool.erase( start, end );
+		p.inhand.reserve( Rules::tiles );
+		p.inhand.assign( hands[ id - 1 ].begin(), hands[ id - 1 ].end() );
 		players.push_back( p );
 	}
 	
 	return players;
 }
 
-void run_game( Tiles &pool, Players &players, Combinations &field )
+// RUMMIKUB_FEED=<file> publishes every move to local spectators, see
+// r_server --watch
+FeedWriter* spectators()
 {
-	size_t fieldSize = -1;
-	int round = 1;
-	while ( pool.size() || fieldSize != field.size() )
+	static unique_ptr< FeedWriter > writer;
+	static bool opened = false;
+	if ( !opened )
 	{
-		fieldSize = field.size();
-		
-		cout << "round: " << round++ << endl;
-		
-		for ( auto &p : players )
+		opened = true;
+		if ( const char *path = getenv( "RUMMIKUB_FEED" ) )
 		{
-			cout << "player: " << p.name() << "\n"
-				<< ">>>\n";
-			generatePlayerInput( p, field, cout );
-			cout << "\n<<<\n";
+			writer.reset( new FeedWriter( path ) );
+		}
+	}
+	return writer.get();
+}
+
+// plays the game on from turn, with a checkpoint every move is saved to it
+// before the player is called
+void run_game( Tiles &pool, Players &players, Combinations &field, size_t &moves, GameLog &log,
+	Checkpoint::Turn turn = Checkpoint::Turn(), Checkpoint *checkpoint = nullptr )
+{
+	static uint32_t games = 0;
+	
+	Arena arena;
+	auto feed = spectators();
+	arena.frame.game = games++;
+	arena.frame.move = 0;
+	
+	// the frame of the move seat just made out of a hand of held tiles
+	auto publish = [&]( size_t seat, size_t held, bool finished )
+	{
+		auto &frame = arena.frame;
+		const auto &hand = players[ seat ].inhand;
+		frame.player = seat;
+		frame.placed = held > hand.size() ? held - hand.size() : 0;
+		frame.pool = pool.size();
+		frame.hand = hand.size();
+		frame.finished = finished;
+		feed::difference( arena.previous, field, frame );
+		feed->publish( frame );
+		++frame.move;
+	};
+	
+	size_t fieldSize = turn.fieldSize;
+	while ( turn.seat || pool.size() || fieldSize != field.size() )
+	{
+		if ( !turn.seat )
+		{
+			fieldSize = field.size();
 			
+			log( logging::Level::moves ) << "round: " << turn.round << '\n';
+		}
+		
+		for ( ; turn.seat < players.size(); ++turn.seat )
+		{
+			const size_t seat = turn.seat;
+			auto &p = players[ seat ];
+			const size_t held = p.inhand.size();
+			if ( feed )
+			{
+				arena.previous = field;
+			}
 			try
 			{
-				run_move( p, pool, field );
+				if ( checkpoint )
+				{
+					// the operator stopping the run is not an attempt at this move
+					const bool stop = Checkpoint::stopping();
+					if ( stop && turn.resumed )
+					{
+						--turn.resumed;
+					}
+					
+					turn.fieldSize = fieldSize;
+					checkpoint->begin( turn );
+					checkpoint->add( pool );
+					for ( auto &other : players )
+					{
+						checkpoint->add( other.inhand );
+					}
+					checkpoint->add( field );
+					checkpoint->commit();
+					
+					if ( stop )
+					{
+						throw Checkpoint::Stopped();
+					}
+				}
+				
+#ifdef RUMMIKUB_ALLOC_PROFILE
+				const auto before = profile::counters();
+#endif
+				try
+				{
+					run_move( p, pool, field, arena, log );
+					++moves;
+					++turn.moves;
+					turn.resumed = 0;
+				}
+				catch ( const exception &err )
+				{
+					p.disqualified = err.what();
+					throw;
+				}
+				
+#ifdef RUMMIKUB_ALLOC_PROFILE
+				cerr << "alloc move " << p.name() << " round " << turn.round << ": ";
+				profile::report( cerr, profile::since( before ) );
+#endif
 			}
-			catch ( const exception &err )
+			catch ( ... )
 			{
-				p.disqualified = err.what();
+				// the game ends here, spectators see it finish
+				if ( feed )
+				{
+					publish( seat, held, true );
+				}
 				throw;
 			}
 			
+			if ( feed )
+			{
+				publish( seat, held, p.inhand.empty() ||
+					( seat + 1 == players.size() && pool.empty() && fieldSize == field.size() ) );
+			}
+			
+			log.flush();
+			
 			if ( p.inhand.empty() )
 			{
 				return;
 			}
 		}
+		
+		turn.seat = 0;
+		++turn.round;
 	}
 	
-	cout << "players are unable to make another combination\n";
+	log( logging::Level::results ) << "players are unable to make another combination\n";
 }
 
-int main( int argc, char *argv[] )
+// plays one game with the tiles shuffled by seed, 1 when it ended early
+int play_game( const Strings &executables, uint64_t seed, size_t &moves )
 {
 	Tiles pool;
 	Players players;
 	Combinations field;
+	GameLog log;
 	
 	try
 	{
-		if ( argc < 2 )
+		if ( executables.empty() )
 		{
 			throw runtime_error( "no clients specified" );
 		}
 		
-		pool = init_tiles();
-		players = getPlayers( Strings( argv + 1, argv + argc ), pool );
+		{
+			profile::Scope phase( profile::Phase::init );
+			pool = init_tiles( seed );
+		}
+		{
+			profile::Scope phase( profile::Phase::deal );
+			players = getPlayers( executables, pool );
+		}
 		
-		run_game( pool, players, field );
+		run_game( pool, players, field, moves, log );
 	}
 	catch ( const exception &err )
 	{
-		cout << err.what() << endl;
+		log( logging::Level::results ) << err.what() << '\n';
 		
-		endGame( pool, field, players );
+		profile::Scope phase( profile::Phase::score );
+		endGame( pool, field, players, log );
 		
 		return 1;
 	}
 	
-	endGame( pool, field, players );
+	profile::Scope phase( profile::Phase::score );
+	endGame( pool, field, players, log );
+	
+	return 0;
+}
+
+// plays the seeds 0 to games - 1 with the game transcript discarded and
+// writes the throughput and the time share of every phase as json:
+//   r_server --bench <games> <client> <client> [...]
+int bench( int argc, char *argv[] )
+{
+	if ( argc < 4 )
+	{
+		cerr << "usage: " << argv[ 0 ] << " --bench <games> <client> <client> [...]\n";
+		return 1;
+	}
+	
+	const size_t games = stoul( argv[ 2 ] );
+	const Strings executables( argv + 3, argv + argc );
+	
+	logging::setLevel( logging::Level::silent );
+	
+	size_t moves = 0, aborted = 0;
+	profile::startTiming();
+	const auto start = chrono::steady_clock::now();
+	for ( size_t game = 0; game < games; ++game )
+	{
+		aborted += play_game( executables, game, moves );
+	}
+	const double seconds = chrono::duration< double >( chrono::steady_clock::now() - start ).count();
+	const auto phases = profile::seconds();
+	
+	double measured = 0;
+	for ( auto s : phases )
+	{
+		measured += s;
+	}
+	
+	cout << "{\n"
+		<< "\t\"rules\": { \"colors\": " << Rules::colors << ", \"numbers\": " << Rules::numbers
+		<< ", \"copies\": " << Rules::copies << ", \"jokers\": " << Rules::jokers << " },\n"
+		<< "\t\"games\": " << games << ",\n"
+		<< "\t\"aborted\": " << aborted << ",\n"
+		<< "\t\"moves\": " << moves << ",\n"
+		<< "\t\"seconds\": " << seconds << ",\n"
+		<< "\t\"games_per_sec\": " << games / seconds << ",\n"
+		<< "\t\"moves_per_sec\": " << moves / seconds << ",\n"
+		<< "\t\"phases\": {\n";
+	for ( size_t i = 0; i < phases.size(); ++i )
+	{
+		cout << "\t\t\"" << profile::name( profile::Phase( i ) ) << "\": { \"seconds\": " << phases[ i ]
+			<< ", \"share\": " << ( measured > 0 ? phases[ i ] / measured : 0 ) << " }"
+			<< ( i + 1 < phases.size() ? ",\n" : "\n" );
+	}
+	cout << "\t}\n"
+		<< "}\n";
+	
+	return 0;
+}
+
+// plays the seeds 0 to games - 1 between clients, every game like a single
+// run of the server, and adds up the results like --selfplay:
+//   r_server --tournament <games> [--shard <index>/<count>] [--results <file>]
+//            [--checkpoint <file>] <client> <client> [...]
+// with --checkpoint a run that is started again with the same arguments goes
+// on from where the last one stopped. a client that takes the server down
+// twice at the same move is disqualified in that game, a run stopped with
+// SIGINT or SIGTERM does not count against anyone
+int tournament( int argc, char *argv[] )
+{
+	if ( argc < 5 )
+	{
+		cerr << "usage: " << argv[ 0 ] << " --tournament <games> [--shard <index>/<count>] [--results <file>] [--checkpoint <file>] <client> <client> [...]\n";
+		return 1;
+	}
+	
+	try
+	{
+		const auto options = results::parseOptions( argc, argv, { "checkpoint" } );
+		
+		const Strings executables( argv + options.first, argv + argc );
+		if ( executables.empty() )
+		{
+			throw runtime_error( "no clients specified" );
+		}
+		
+		const uint64_t begin = options.begin();
+		const uint64_t end = options.end();
+		
+		results::Shard total;
+		total.first = begin;
+		total.players = executables;
+		total.scores.resize( executables.size() );
+		
+		unique_ptr< Checkpoint > checkpoint;
+		if ( options.files.count( "checkpoint" ) )
+		{
+			results::Shard planned = total;
+			planned.games = end - begin;
+			checkpoint.reset( new Checkpoint( options.files.at( "checkpoint" ), planned ) );
+			total = checkpoint->totals();
+		}
+		total.tournament = options.games;
+		total.shard = options.shard;
+		total.shards = options.shards;
+		
+		vector< Tiles > hands;
+		size_t moves = 0;
+		const auto start = chrono::steady_clock::now();
+		for ( auto seed = begin + total.games; seed < end; ++seed )
+		{
+			Tiles pool;
+			Players players;
+			Combinations field;
+			GameLog log;
+			
+			Checkpoint::Turn turn;
+			turn.seed = seed;
+			const size_t before = moves;
+			
+			try
+			{
+				if ( checkpoint && checkpoint->resume( turn, pool, hands, field ) )
+				{
+					Tiles none;
+					players = getPlayers( executables, none );
+					for ( size_t p = 0; p < players.size(); ++p )
+					{
+						players[ p ].inhand = hands[ p ];
+					}
+					
+					if ( turn.resumed > 1 )
+					{
+						auto &p = players[ turn.seat ];
+						p.disqualified = "took the server down";
+						throw runtime_error( p.name() + " took the server down" );
+					}
+				}
+				else
+				{
+					pool = init_tiles( seed );
+					players = getPlayers( executables, pool );
+				}
+				
+				run_game( pool, players, field, moves, log, turn, checkpoint.get() );
+			}
+			catch ( const exception &err )
+			{
+				log( logging::Level::results ) << err.what() << '\n';
+			}
+			
+			endGame( pool, field, players, log );
+			
+			vector< uint64_t > left( players.size() );
+			vector< bool > disqualified( players.size() );
+			for ( auto &p : players )
+			{
+				left[ p.id - 1 ] = points( p.inhand );
+				disqualified[ p.id - 1 ] = !p.disqualified.empty();
+			}
+			const auto score = results::score( left, disqualified );
+			
+			const uint64_t played = turn.moves + moves - before;
+			if ( checkpoint )
+			{
+				checkpoint->finish( played, score );
+			}
+			results::add( total, played, score );
+		}
+		const double seconds = chrono::duration< double >( chrono::steady_clock::now() - start ).count();
+		
+		logging::drain();
+		cout << "games: " << total.games
+			<< ", moves: " << total.moves
+			<< ", seconds: " << seconds << '\n';
+		results::print( cout, total );
+		
+		if ( !options.results.empty() )
+		{
+			results::write( options.results, total );
+		}
+	}
+	catch ( const Checkpoint::Stopped& )
+	{
+		logging::drain();
+		cerr << "stopped, run again with the same arguments to go on" << endl;
+		return 1;
+	}
+	catch ( const exception &err )
+	{
+		cerr << err.what() << endl;
+		return 1;
+	}
 	
 	return 0;
 }
+
+// follows the feed of a running server and prints every move, the frames a
+// slow terminal missed are counted instead:
+//   r_server --watch <file>
+int watch( int argc, char *argv[] )
+{
+	if ( argc < 3 )
+	{
+		cerr << "usage: " << argv[ 0 ] << " --watch <file>\n";
+		return 1;
+	}
+	
+	try
+	{
+		FeedReader reader( argv[ 2 ] );
+		feed::Frame frame;
+		uint64_t dropped = 0;
+		for ( ;; )
+		{
+			if ( !reader.next( frame ) )
+			{
+				this_thread::sleep_for( chrono::milliseconds( 1 ) );
+				continue;
+			}
+			if ( reader.dropped() != dropped )
+			{
+				cout << "dropped " << reader.dropped() - dropped << " frames\n";
+				dropped = reader.dropped();
+			}
+			
+			cout << "game " << frame.game << " move " << frame.move << " player " << int( frame.player );
+			if ( frame.placed )
+			{
+				cout << " placed " << int( frame.placed );
+				for ( size_t i = 0; i < frame.removedSets; ++i )
+				{
+					cout << " -" << int( frame.removed[ i ] );
+				}
+				// each set as +A01,A02,A03
+				bool first = true;
+				for ( size_t i = 0; i < frame.addedBytes; ++i )
+				{
+					const auto id = frame.added[ i ];
+					if ( !id )
+					{
+						first = true;
+						continue;
+					}
+					cout << ( first ? " +" : "," ) << Tile::fromId( id );
+					first = false;
+				}
+			}
+			else
+			{
+				cout << " drew";
+			}
+			cout << " | pool " << frame.pool << " hand " << frame.hand << " sets " << frame.fieldSets
+				<< ( frame.finished ? " | game over" : "" ) << endl;
+		}
+	}
+	catch ( const exception &err )
+	{
+		cerr << err.what() << endl;
+		return 1;
+	}
+}
+
+int main( int argc, char *argv[] )
+{
+#ifdef RUMMIKUB_NATIVE_BOTS
+	if ( argc > 1 && string( argv[ 1 ] ) == "--selfplay" )
+	{
+		return selfplay( argc, argv );
+	}
+	if ( argc > 1 && string( argv[ 1 ] ) == "--analyze" )
+	{
+		return analyze( argc, argv );
+	}
+#endif
+	if ( argc > 1 && string( argv[ 1 ] ) == "--bench" )
+	{
+		return bench( argc, argv );
+	}
+	if ( argc > 1 && string( argv[ 1 ] ) == "--tournament" )
+	{
+		return tournament( argc, argv );
+	}
+	if ( argc > 1 && string( argv[ 1 ] ) == "--merge" )
+	{
+		return merge( argc, argv );
+	}
+	if ( argc > 1 && string( argv[ 1 ] ) == "--watch" )
+	{
+		return watch( argc, argv );
+	}
+	
+#ifdef RUMMIKUB_ALLOC_PROFILE
+	// the allocations of the whole game go to stderr when main returns
+	struct GameReport
+	{
+		profile::Counters start = profile::counters();
+		
+		~GameReport()
+		{
+			cerr << "alloc game: ";
+			profile::report( cerr, profile::since( start ) );
+		}
+	} allocations;
+#endif
+	
+	size_t moves = 0;
+	return play_game( Strings( argv + 1, argv + argc ), 0, moves );
+}
@@ -0,0 +1,206 @@
+#include "profile.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace
+{
+	// constant initialized, so it can be read in operator new on any thread
+	// at any time
+	thread_local int current = int( profile::Phase::background );
+	
+	// static initialization runs on the main thread
+	struct MainThread
+	{
+		MainThread()
+		{
+			current = int( profile::Phase::other );
+		}
+	} mainThread;
+	
+	const char *names[] = { "other", "init", "deal", "format", "call", "parse", "diff", "validate", "score", "background" };
+	
+	// timing is only done by the thread that started it
+	thread_local bool timing = false;
+	chrono::steady_clock::time_point switched;
+	array< double, size_t( profile::Phase::count ) > elapsed {};
+}
+
+namespace profile
+{
+	const char* name( Phase phase )
+	{
+		return names[ size_t( phase ) ];
+	}
+	
+	Phase phase()
+	{
+		return Phase( current );
+	}
+	
+	void enter( Phase phase )
+	{
+		if ( timing )
+		{
+			const auto now = chrono::steady_clock::now();
+			elapsed[ current ] += chrono::duration< double >( now - switched ).count();
+			switched = now;
+		}
+		current = int( phase );
+	}
+	
+	void startTiming()
+	{
+		elapsed.fill( 0 );
+		switched = chrono::steady_clock::now();
+		timing = true;
+	}
+	
+	array< double, size_t( Phase::count ) > seconds()
+	{
+		enter( phase() );
+		return elapsed;
+	}
+}
+
+#ifdef RUMMIKUB_ALLOC_PROFILE
+
+namespace
+{
+	struct AtomicCounter
+	{
+		atomic< size_t > allocations;
+		atomic< size_t > frees;
+		atomic< size_t > bytes;
+	};
+	
+	// plain globals with constant initialization, operator new can run
+	// before any constructor in this file would have
+	AtomicCounter counted[ size_t( profile::Phase::count ) ];
+	
+	void* allocate( size_t size )
+	{
+		auto &c = counted[ current ];
+		c.allocations.fetch_add( 1, memory_order_relaxed );
+		c.bytes.fetch_add( size, memory_order_relaxed );
+		
+		void *p = malloc( size ? size : 1 );
+		if ( !p )
+		{
+			throw bad_alloc();
+		}
+		return p;
+	}
+	
+	void release( void *p )
+	{
+		if ( p )
+		{
+			counted[ current ].frees.fetch_add( 1, memory_order_relaxed );
+			free( p );
+		}
+	}
+}
+
+namespace profile
+{
+	Counters counters()
+	{
+		Counters result;
+		for ( size_t i = 0; i < result.size(); ++i )
+		{
+			result[ i ].allocations = counted[ i ].allocations.load( memory_order_relaxed );
+			result[ i ].frees = counted[ i ].frees.load( memory_order_relaxed );
+			result[ i ].bytes = counted[ i ].bytes.load( memory_order_relaxed );
+		}
+		return result;
+	}
+	
+	Counters since( const Counters &earlier )
+	{
+		auto result = counters();
+		for ( size_t i = 0; i < result.size(); ++i )
+		{
+			result[ i ].allocations -= earlier[ i ].allocations;
+			result[ i ].frees -= earlier[ i ].frees;
+			result[ i ].bytes -= earlier[ i ].bytes;
+		}
+		return result;
+	}
+	
+	void report( ostream &stream, const Counters &counters )
+	{
+		Counter total {};
+		for ( size_t i = 0; i < counters.size(); ++i )
+		{
+			total.allocations += counters[ i ].allocations;
+			total.frees += counters[ i ].frees;
+			total.bytes += counters[ i ].bytes;
+			if ( counters[ i ].allocations )
+			{
+				stream << names[ i ] << ' ' << counters[ i ].allocations << '/' << counters[ i ].bytes << "B, ";
+			}
+		}
+		stream << "total " << total.allocations << '/' << total.bytes << "B, frees " << total.frees << '\n';
+	}
+}
+
+void* operator new( size_t size )
+{
+	return allocate( size );
+}
+
+void* operator new[]( size_t size )
+{
+	return allocate( size );
+}
+
+void* operator new( size_t size, const nothrow_t& ) noexcept
+{
+	try
+	{
+		return allocate( size );
+	}
+	catch ( const bad_alloc& )
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[]( size_t size, const nothrow_t& ) noexcept
+{
+	try
+	{
+		return allocate( size );
+	}
+	catch ( const bad_alloc& )
+	{
+		return nullptr;
+	}
+}
+
+void operator delete( void *p ) noexcept
+{
+	release( p );
+}
+
+void operator delete[]( void *p ) noexcept
+{
+	release( p );
+}
+
+void operator delete( void *p, const nothrow_t& ) noexcept
+{
+	release( p );
+}
+
+void operator delete[]( void *p, const nothrow_t& ) noexcept
+{
+	release( p );
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+
+// per phase accounting of the server. the time spent in every phase is
+// measured once startTiming() was called, --bench does that. allocations are
+// counted when built with -DRUMMIKUB_ALLOC_PROFILE=ON, global operator new
+// and delete are replaced then. every thread has its own phase: the main
+// thread starts in other, any other thread in background unless it enters a
+// phase itself, like the thread a bot is called on enters call
+namespace profile
+{
+	enum class Phase
+	{
+		other,
+		init,       // init_tiles
+		deal,       // getPlayers
+		format,     // generatePlayerInput
+		call,       // Dll::call, the bot
+		parse,      // parse
+		diff,       // diff
+		validate,   // ownership and checkCombinations
+		score,      // endGame
+		background, // threads that did not enter a phase, the logger
+		count
+	};
+	
+	const char* name( Phase phase );
+	
+	// the phase of the calling thread
+	Phase phase();
+	void enter( Phase phase );
+	
+	// seconds spent in every phase since timing started, each phase counts
+	// only the time until the next one is entered. only the thread that
+	// started timing is timed
+	void startTiming();
+	std::array< double, size_t( Phase::count ) > seconds();
+	
+	// counts against phase for as long as it lives
+	class Scope
+	{
+		public:
+			
+			explicit Scope( Phase phase ) :
+				previous_( profile::phase() )
+			{
+				enter( phase );
+			}
+			
+			~Scope()
+			{
+				enter( previous_ );
+			}
+			
+			Scope( const Scope& ) = delete;
+			Scope& operator = ( const Scope& ) = delete;
+			
+		private:
+			Phase previous_;
+	};
+	
+#ifdef RUMMIKUB_ALLOC_PROFILE
+	
+	struct Counter
+	{
+		size_t allocations;
+		size_t frees;
+		size_t bytes;
+	};
+	
+	using Counters = std::array< Counter, size_t( Phase::count ) >;
+	
+	// everything counted since the program started
+	Counters counters();
+	
+	// the difference between two snapshots
+	Counters since( const Counters &earlier );
+	
+	// one line, every phase that allocated as allocations/bytes
+	void report( std::ostream &stream, const Counters &counters );
+	
+#endif
+}
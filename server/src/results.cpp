@@ -0,0 +1,331 @@
+#include "results.h"
+#include "bytes.h"
+#include "tile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+	const char magic[ 4 ] = { 'R', 'K', 'S', 'R' };
+	const uint32_t version = 2;
+	
+	using File = unique_ptr< FILE, int (*)( FILE* ) >;
+	
+	using bytes::put;
+	using bytes::take;
+	
+	// magic, version, tile ids, players, tournament, shard, shards, first,
+	// games and moves
+	const size_t headerSize = 56;
+	
+	// a name and the wins, points and disqualifications of a player
+	const size_t playerSize = 4 + 3 * 8;
+	
+	// a plain decimal that fits a shard index, no sign, spaces or suffix
+	bool parseIndex( const string &text, size_t &out )
+	{
+		if ( text.empty() || text.size() > 9 || text.find_first_not_of( "0123456789" ) != string::npos )
+		{
+			return false;
+		}
+		out = stoul( text );
+		return true;
+	}
+}
+
+vector< size_t > results::rank( const vector< uint64_t > &points, const vector< bool > &disqualified )
+{
+	vector< size_t > seats( points.size() );
+	for ( size_t i = 0; i < seats.size(); ++i )
+	{
+		seats[ i ] = i;
+	}
+	stable_sort( seats.begin(), seats.end(),
+		[&]( size_t a, size_t b )
+		{
+			if ( disqualified[ a ] != disqualified[ b ] )
+			{
+				return !disqualified[ a ];
+			}
+			return points[ a ] < points[ b ];
+		}
+	);
+	return seats;
+}
+
+vector< results::Score > results::score( const vector< uint64_t > &points, const vector< bool > &disqualified )
+{
+	vector< Score > game( points.size() );
+	for ( size_t i = 0; i < game.size(); ++i )
+	{
+		game[ i ].points = points[ i ];
+		game[ i ].disqualified = disqualified[ i ];
+	}
+	
+	const auto first = rank( points, disqualified ).front();
+	game[ first ].wins = !disqualified[ first ];
+	return game;
+}
+
+void results::add( Shard &total, uint64_t moves, const vector< Score > &game )
+{
+	++total.games;
+	total.moves += moves;
+	for ( size_t p = 0; p < total.scores.size() && p < game.size(); ++p )
+	{
+		total.scores[ p ].wins += game[ p ].wins;
+		total.scores[ p ].points += game[ p ].points;
+		total.scores[ p ].disqualified += game[ p ].disqualified;
+	}
+}
+
+uint64_t results::sliceBegin( uint64_t games, size_t index, size_t count )
+{
+	// games * index / count without the product, the remainder times index
+	// stays below count squared
+	return games / count * index + games % count * index / count;
+}
+
+results::Options results::parseOptions( int argc, char *argv[], const vector< string > &names )
+{
+	Options options;
+	if ( argc < 3 || string( argv[ 2 ] ).find_first_not_of( "0123456789" ) != string::npos )
+	{
+		throw runtime_error( "expected the number of games" );
+	}
+	options.games = stoull( argv[ 2 ] );
+	
+	int first = 3;
+	for ( ; argc > first + 1 && string( argv[ first ] ).compare( 0, 2, "--" ) == 0; first += 2 )
+	{
+		const string option = argv[ first ] + 2, value = argv[ first + 1 ];
+		if ( option == "results" )
+		{
+			options.results = value;
+		}
+		else if ( option == "shard" )
+		{
+			// exactly <index>/<count> with index < count
+			const auto slash = value.find( '/' );
+			if ( slash == string::npos ||
+				!parseIndex( value.substr( 0, slash ), options.shard ) ||
+				!parseIndex( value.substr( slash + 1 ), options.shards ) ||
+				options.shard >= options.shards )
+			{
+				throw runtime_error( "bad shard, expected <index>/<count> with index < count: " + value );
+			}
+		}
+		else if ( find( names.begin(), names.end(), option ) != names.end() )
+		{
+			options.files[ option ] = value;
+		}
+		else
+		{
+			throw runtime_error( "unknown option: --" + option + ' ' + value );
+		}
+	}
+	options.first = first;
+	return options;
+}
+
+void results::write( const string &path, const Shard &shard )
+{
+	vector< uint8_t > out( magic, magic + 4 );
+	put< uint32_t >( out, version );
+	put< uint32_t >( out, Rules::ids );
+	put< uint32_t >( out, shard.players.size() );
+	put( out, shard.tournament );
+	put( out, shard.shard );
+	put( out, shard.shards );
+	put( out, shard.first );
+	put( out, shard.games );
+	put( out, shard.moves );
+	for ( size_t p = 0; p < shard.players.size(); ++p )
+	{
+		put< uint32_t >( out, shard.players[ p ].size() );
+		out.insert( out.end(), shard.players[ p ].begin(), shard.players[ p ].end() );
+		put( out, shard.scores[ p ].wins );
+		put( out, shard.scores[ p ].points );
+		put( out, shard.scores[ p ].disqualified );
+	}
+	
+	File file( fopen( path.c_str(), "wb" ), fclose );
+	if ( !file )
+	{
+		throw runtime_error( "could not open results: " + path );
+	}
+	if ( !bytes::writeAll( file.get(), out.data(), out.size() ) || fflush( file.get() ) != 0 )
+	{
+		throw runtime_error( "could not write results: " + path );
+	}
+}
+
+results::Shard results::read( const string &path )
+{
+	File file( fopen( path.c_str(), "rb" ), fclose );
+	if ( !file )
+	{
+		throw runtime_error( "could not open results: " + path );
+	}
+	vector< uint8_t > data;
+	uint8_t buffer[ 4096 ];
+	for ( size_t n; ( n = fread( buffer, 1, sizeof( buffer ), file.get() ) ) > 0; )
+	{
+		data.insert( data.end(), buffer, buffer + n );
+	}
+	
+	const uint8_t *p = data.data(), *end = p + data.size();
+	if ( data.size() < 8 || memcmp( p, magic, 4 ) != 0 || bytes::get< uint32_t >( p + 4 ) != version )
+	{
+		throw runtime_error( "not a results file: " + path );
+	}
+	if ( data.size() < headerSize )
+	{
+		throw runtime_error( "truncated results: " + path );
+	}
+	p += 8;
+	if ( take< uint32_t >( p ) != Rules::ids )
+	{
+		throw runtime_error( "results of another tile set: " + path );
+	}
+	
+	Shard shard;
+	const auto players = take< uint32_t >( p );
+	shard.tournament = take< uint64_t >( p );
+	shard.shard = take< uint32_t >( p );
+	shard.shards = take< uint32_t >( p );
+	shard.first = take< uint64_t >( p );
+	shard.games = take< uint64_t >( p );
+	shard.moves = take< uint64_t >( p );
+	for ( size_t i = 0; i < players; ++i )
+	{
+		if ( size_t( end - p ) < playerSize )
+		{
+			throw runtime_error( "truncated results: " + path );
+		}
+		const size_t length = take< uint32_t >( p );
+		if ( length > 256 || size_t( end - p ) < length + playerSize - 4 )
+		{
+			throw runtime_error( "corrupt results: " + path );
+		}
+		shard.players.push_back( string( p, p + length ) );
+		p += length;
+		
+		Score score;
+		score.wins = take< uint64_t >( p );
+		score.points = take< uint64_t >( p );
+		score.disqualified = take< uint64_t >( p );
+		shard.scores.push_back( score );
+	}
+	return shard;
+}
+
+void results::print( ostream &out, const Shard &shard )
+{
+	for ( size_t p = 0; p < shard.players.size(); ++p )
+	{
+		out << shard.players[ p ] << '(' << p + 1 << ")"
+			<< ": wins " << shard.scores[ p ].wins
+			<< ", points " << shard.scores[ p ].points
+			<< ", disqualified " << shard.scores[ p ].disqualified << '\n';
+	}
+}
+
+int merge( int argc, char *argv[] )
+{
+	if ( argc < 3 )
+	{
+		cerr << "usage: " << argv[ 0 ] << " --merge <results> [<results> [...]]\n";
+		return 1;
+	}
+	
+	try
+	{
+		vector< results::Shard > shards;
+		for ( int i = 2; i < argc; ++i )
+		{
+			shards.push_back( results::read( argv[ i ] ) );
+			auto &shard = shards.back(), &front = shards.front();
+			if ( shard.players != front.players )
+			{
+				throw runtime_error( string( "results of other bots: " ) + argv[ i ] );
+			}
+			if ( shard.tournament != front.tournament || shard.shards != front.shards )
+			{
+				throw runtime_error( string( "results of another tournament: " ) + argv[ i ] );
+			}
+			if ( shard.shard >= shard.shards ||
+				shard.first != results::sliceBegin( shard.tournament, shard.shard, shard.shards ) ||
+				shard.first + shard.games != results::sliceBegin( shard.tournament, shard.shard + 1, shard.shards ) )
+			{
+				throw runtime_error( string( "results do not cover their shard: " ) + argv[ i ] );
+			}
+		}
+		sort( shards.begin(), shards.end(),
+			[]( const results::Shard &a, const results::Shard &b )
+			{
+				return a.shard < b.shard;
+			}
+		);
+		
+		// every shard exactly once, so the seeds 0 to tournament - 1 are
+		// all counted and none twice
+		string missing;
+		size_t expected = 0;
+		for ( auto &shard : shards )
+		{
+			if ( shard.shard < expected )
+			{
+				throw runtime_error( "shard " + to_string( shard.shard ) + " given twice" );
+			}
+			for ( ; expected < shard.shard; ++expected )
+			{
+				missing += ' ' + to_string( expected );
+			}
+			++expected;
+		}
+		for ( ; expected < shards.front().shards; ++expected )
+		{
+			missing += ' ' + to_string( expected );
+		}
+		if ( !missing.empty() )
+		{
+			throw runtime_error( "missing shards of " + to_string( shards.front().shards ) + ":" + missing );
+		}
+		
+		results::Shard total;
+		total.tournament = shards.front().tournament;
+		total.players = shards.front().players;
+		total.scores.resize( total.players.size() );
+		for ( auto &shard : shards )
+		{
+			total.games += shard.games;
+			total.moves += shard.moves;
+			for ( size_t p = 0; p < total.scores.size(); ++p )
+			{
+				total.scores[ p ].wins += shard.scores[ p ].wins;
+				total.scores[ p ].points += shard.scores[ p ].points;
+				total.scores[ p ].disqualified += shard.scores[ p ].disqualified;
+			}
+		}
+		
+		cout << "shards: " << shards.size()
+			<< ", games: " << total.games
+			<< ", moves: " << total.moves << '\n';
+		results::print( cout, total );
+	}
+	catch ( const exception &err )
+	{
+		cerr << err.what() << endl;
+		return 1;
+	}
+	
+	return 0;
+}
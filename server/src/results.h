@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+// totals of a slice of a tournament, written by every shard of --selfplay so
+// the shards can run as separate processes and be added up afterwards. all
+// integers are stored in host byte order.
+//
+//   file    "RKSR" u32 version, u32 tile ids, u32 players, u64 tournament
+//           games, u32 shard, u32 shards, u64 first seed, u64 games,
+//           u64 moves
+//   player  u32 name length, name, u64 wins, u64 points, u64 disqualified
+namespace results
+{
+	struct Score
+	{
+		uint64_t wins { 0 };
+		uint64_t points { 0 };
+		uint64_t disqualified { 0 };
+	};
+	
+	struct Shard
+	{
+		uint64_t tournament { 0 };  // the whole tournament plays seeds 0 to tournament - 1
+		uint32_t shard { 0 };       // index of this slice out of shards
+		uint32_t shards { 1 };
+		uint64_t first { 0 };       // seeds first to first + games - 1 were played
+		uint64_t games { 0 };
+		uint64_t moves { 0 };
+		std::vector< std::string > players;
+		std::vector< Score > scores;
+	};
+	
+	// the seats of one game from first to last place: the fewest points left
+	// in hand comes first, disqualified players come after the others and a
+	// tie goes to the earlier seat
+	std::vector< size_t > rank( const std::vector< uint64_t > &points, const std::vector< bool > &disqualified );
+	
+	// the score of one game in seat order, the first place wins unless it is
+	// disqualified
+	std::vector< Score > score( const std::vector< uint64_t > &points, const std::vector< bool > &disqualified );
+	
+	// adds the score of one game to total
+	void add( Shard &total, uint64_t moves, const std::vector< Score > &game );
+	
+	// the seeds of shard index of count, a contiguous slice of 0 to games - 1
+	uint64_t sliceBegin( uint64_t games, size_t index, size_t count );
+	
+	// the command line the tournament modes share, from argv[ 2 ] on:
+	//   <games> [--shard <index>/<count>] [--results <file>] [--<name> <file>]
+	// where names are the further options of the mode
+	struct Options
+	{
+		uint64_t games { 0 };
+		size_t shard { 0 };
+		size_t shards { 1 };
+		std::string results;
+		std::map< std::string, std::string > files;  // by name, without the dashes
+		int first { 0 };                              // first argument after the options
+		
+		uint64_t begin() const
+		{
+			return sliceBegin( games, shard, shards );
+		}
+		
+		uint64_t end() const
+		{
+			return sliceBegin( games, shard + 1, shards );
+		}
+	};
+	
+	// throws on an unknown option or a malformed shard
+	Options parseOptions( int argc, char *argv[], const std::vector< std::string > &names );
+	
+	void write( const std::string &path, const Shard &shard );
+	Shard read( const std::string &path );
+	
+	// one line per player
+	void print( std::ostream &out, const Shard &shard );
+}
+
+// adds up the result files of the shards of a tournament. they have to be
+// played by the same bots and every shard has to be there exactly once:
+//   r_server --merge <results> [<results> [...]]
+int merge( int argc, char *argv[] );
@@ -0,0 +1,171 @@
+#include "selfplay.h"
+#include "bots.h"
+#include "dataset.h"
+#include "profile.h"
+#include "results.h"
+
+#include <iostream>
+#include <chrono>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+	using results::Score;
+	
+	// plays one game with the given deal, returns the number of moves
+	size_t play( uint64_t seed, vector< unique_ptr< Strategy > > &bots, vector< Score > &scores, Move &turn, DatasetWriter *dataset )
+	{
+		Tiles pool = init_tiles( seed );
+		const auto hands = deal( pool, bots.size() );
+		
+		GameState state( move( pool ), hands );
+		
+		if ( dataset )
+		{
+			dataset->beginGame( seed );
+		}
+		
+		size_t moves = 0;
+		while ( !state.finished() )
+		{
+			const auto player = state.current();
+			{
+				profile::Scope phase( profile::Phase::call );
+				bots[ player ]->play( state, turn );
+			}
+			if ( dataset )
+			{
+				dataset->turn( state, turn );
+			}
+			profile::Scope phase( profile::Phase::validate );
+			if ( state.apply( turn ) != MoveError::none )
+			{
+				break;
+			}
+			++moves;
+		}
+		
+		if ( dataset )
+		{
+			dataset->endGame( state );
+		}
+		
+		// scored like a game of --tournament, a game that ends with a bot
+		// disqualified is scored as it stands
+		vector< uint64_t > points;
+		vector< bool > disqualified;
+		for ( size_t p = 0; p < bots.size(); ++p )
+		{
+			points.push_back( state.hand( p ).points() );
+			disqualified.push_back( p == state.current() && !state.finished() );
+		}
+		const auto game = results::score( points, disqualified );
+		for ( size_t p = 0; p < bots.size(); ++p )
+		{
+			scores[ p ].wins += game[ p ].wins;
+			scores[ p ].points += game[ p ].points;
+			scores[ p ].disqualified += game[ p ].disqualified;
+		}
+		
+		return moves;
+	}
+}
+
+int selfplay( int argc, char *argv[] )
+{
+	if ( argc < 4 )
+	{
+		cerr << "usage: " << argv[ 0 ] << " --selfplay <games> [--shard <index>/<count>] [--results <file>] [--dataset <file>] <bot> <bot> [...]\n";
+		return 1;
+	}
+	
+	results::Options options;
+	unique_ptr< DatasetWriter > dataset;
+	try
+	{
+		options = results::parseOptions( argc, argv, { "dataset" } );
+		if ( options.files.count( "dataset" ) )
+		{
+			dataset.reset( new DatasetWriter( options.files[ "dataset" ] ) );
+		}
+	}
+	catch ( const exception &err )
+	{
+		cerr << err.what() << '\n';
+		return 1;
+	}
+	const int first = options.first;
+	
+	vector< unique_ptr< Strategy > > bots;
+	for ( int i = first; i < argc; ++i )
+	{
+		bots.push_back( makeStrategy( argv[ i ] ) );
+		if ( !bots.back() )
+		{
+			cerr << "unknown bot: " << argv[ i ] << ", available:";
+			for ( auto &name : strategyNames() )
+			{
+				cerr << ' ' << name;
+			}
+			cerr << '\n';
+			return 1;
+		}
+	}
+	
+	vector< Score > scores( bots.size() );
+	Move move;
+	size_t moves = 0;
+	
+#ifdef RUMMIKUB_ALLOC_PROFILE
+	const auto before = profile::counters();
+#endif
+	
+	// shard i of n plays its own contiguous slice of the seeds 0 to games - 1
+	const uint64_t begin = options.begin();
+	const uint64_t end = options.end();
+	
+	const auto start = chrono::steady_clock::now();
+	for ( auto seed = begin; seed < end; ++seed )
+	{
+		moves += play( seed, bots, scores, move, dataset.get() );
+	}
+	if ( dataset )
+	{
+		dataset->close();
+	}
+	const double seconds = chrono::duration< double >( chrono::steady_clock::now() - start ).count();
+	
+	results::Shard result;
+	result.tournament = options.games;
+	result.shard = options.shard;
+	result.shards = options.shards;
+	result.first = begin;
+	result.games = end - begin;
+	result.moves = moves;
+	result.scores = scores;
+	for ( auto &bot : bots )
+	{
+		result.players.push_back( bot->name() );
+	}
+	
+	cout << "games: " << result.games
+		<< ", moves: " << moves
+		<< ", seconds: " << seconds
+		<< ", games/sec: " << result.games / seconds
+		<< ", moves/sec: " << moves / seconds << '\n';
+	results::print( cout, result );
+	
+	if ( !options.results.empty() )
+	{
+		results::write( options.results, result );
+	}
+	
+#ifdef RUMMIKUB_ALLOC_PROFILE
+	cerr << "alloc " << result.games << " games: ";
+	profile::report( cerr, profile::since( before ) );
+#endif
+	
+	return 0;
+}
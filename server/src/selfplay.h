@@ -0,0 +1,12 @@
+#pragma once
+
+// plays games between native bots without any console or bot i/o:
+//   r_server --selfplay <games> [--shard <index>/<count>] [--results <file>]
+//            [--dataset <file>] <bot> <bot> [...]
+// game n is dealt from seed n. with --shard only the index-th of count equal
+// slices of the seeds is played, so a tournament can be split over local
+// processes and their --results files added up with r_server --merge:
+//   for i in 0 1 2 3; do r_server --selfplay 10000 --shard $i/4 --results r$i greedy append & done; wait
+//   r_server --merge r0 r1 r2 r3
+// with --dataset every turn is recorded, see DatasetWriter
+int selfplay( int argc, char *argv[] );